@@ -0,0 +1,377 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "government.h"
+
+static std::atomic<size_t> allocation_count{0};
+
+__attribute__((noinline)) static void *tryAllocate(size_t size, size_t alignment = 0) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    void *memory = nullptr;
+    return ::posix_memalign(&memory, std::max(alignment, sizeof(void *)), size) == 0 ? memory : nullptr;
+}
+
+static void *allocate(size_t size, size_t alignment = 0) {
+    if (void *memory = tryAllocate(size, alignment)) return memory;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) static void release(void *memory) noexcept { std::free(memory); }
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return tryAllocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return tryAllocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocate(size, static_cast<size_t>(alignment)); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return tryAllocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return tryAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *memory) noexcept { release(memory); }
+void operator delete[](void *memory) noexcept { release(memory); }
+void operator delete(void *memory, size_t) noexcept { release(memory); }
+void operator delete[](void *memory, size_t) noexcept { release(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { release(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { release(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { release(memory); }
+void operator delete[](void *memory, std::align_val_t) noexcept { release(memory); }
+void operator delete(void *memory, size_t, std::align_val_t) noexcept { release(memory); }
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept { release(memory); }
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t &) noexcept { release(memory); }
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t &) noexcept { release(memory); }
+
+struct Measurement {
+    double seconds;
+    size_t allocations;
+};
+
+template <typename Body>
+static Measurement measure(Body body) {
+    size_t allocations_before = allocation_count.load();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto stop = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double>(stop - start).count(), allocation_count.load() - allocations_before};
+}
+
+static int benchAccessors(size_t reads) {
+    std::vector<GovernmentProject *> projects;
+    for (size_t i = 0; i < 1024; ++i) {
+        projects.push_back(new GovernmentProject("Regional Infrastructure Project " + std::to_string(i),
+                                                 "Department of Transportation", true, 1000000,
+                                                 std::vector<ProjectAction *>()));
+    }
+    size_t sink = 0;
+    Measurement copied = measure([&] {
+        for (size_t i = 0; i < reads; ++i) {
+            const GovernmentProject &project = *projects[i % projects.size()];
+            std::string name = project.getProjectName();
+            std::string department = project.getDepartment();
+            sink += name.size() + department.size();
+        }
+    });
+    Measurement viewed = measure([&] {
+        for (size_t i = 0; i < reads; ++i) {
+            const GovernmentProject &project = *projects[i % projects.size()];
+            std::string_view name = project.getProjectName();
+            std::string_view department = project.getDepartment();
+            sink += name.size() + department.size();
+        }
+    });
+    double millions = reads / 1e6;
+    std::printf("{\"benchmark\":\"accessors\",\"reads\":%zu,"
+                "\"copy_allocations_per_million\":%.1f,\"copy_ns_per_read\":%.2f,"
+                "\"view_allocations_per_million\":%.1f,\"view_ns_per_read\":%.2f,\"checksum\":%zu}\n",
+                reads, copied.allocations / millions, copied.seconds * 1e9 / reads,
+                viewed.allocations / millions, viewed.seconds * 1e9 / reads, sink);
+    for (auto *project : projects) {
+        delete project;
+    }
+    return 0;
+}
+
+static long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+enum class ActionKind { Approve, Adjust, Complete, Conditional, Transfer, Freeze };
+
+static const char *const kActionNames[] = {"approve", "adjust", "complete", "conditional", "transfer", "freeze"};
+static const char *const kDepartments[] = {"Transportation", "Education", "Health", "Culture",
+                                           "Environment", "Urban Development", "Defense", "Energy"};
+
+struct ProcessOptions {
+    std::vector<size_t> sizes = {1000, 100000, 1000000};
+    size_t chain = 4;
+    std::vector<double> mix = {1, 2, 1, 1, 1, 0.25};
+    std::string mode = "serial";
+    size_t threads = std::thread::hardware_concurrency();
+    size_t repeat = 3;
+    uint64_t seed = 42;
+    bool arena = false;
+};
+
+struct HeapFactory {
+    template <typename T, typename... Args>
+    T *create(Args &&...args) { return new T(std::forward<Args>(args)...); }
+};
+
+struct ArenaFactory {
+    ProjectRegistry &registry;
+    template <typename T, typename... Args>
+    T *create(Args &&...args) { return registry.createAction<T>(std::forward<Args>(args)...); }
+};
+
+class ChainGenerator {
+    std::mt19937_64 rng;
+    std::discrete_distribution<int> pick;
+    std::uniform_int_distribution<int> amount{-500, 1500};
+    size_t length;
+
+    template <typename Factory>
+    ProjectAction *makeAction(ActionKind kind, Factory &factory) {
+        switch (kind) {
+        case ActionKind::Approve: return factory.template create<ApproveFunding>();
+        case ActionKind::Adjust: return factory.template create<AdjustBudget>(amount(rng) * 1000.0);
+        case ActionKind::Complete: return factory.template create<CompleteProject>();
+        case ActionKind::Conditional:
+            return factory.template create<ConditionalApproval>(factory.template create<ApproveFunding>(),
+                                                                 (amount(rng) + 500) * 1000.0);
+        case ActionKind::Transfer: return factory.template create<DepartmentTransfer>(kDepartments[rng() % 8]);
+        case ActionKind::Freeze: return factory.template create<BudgetFreeze>();
+        }
+        return nullptr;
+    }
+
+public:
+    ChainGenerator(const ProcessOptions &options)
+        : rng(options.seed), pick(options.mix.begin(), options.mix.end()), length(options.chain) {}
+
+    template <typename Factory>
+    std::vector<ProjectAction *> next(Factory &factory) {
+        std::vector<ProjectAction *> actions;
+        actions.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            actions.push_back(makeAction(static_cast<ActionKind>(pick(rng)), factory));
+        }
+        return actions;
+    }
+
+    std::string_view department() { return kDepartments[rng() % 8]; }
+    double budget() { return (rng() % 5000) * 1000.0; }
+    bool funded() { return rng() % 2; }
+};
+
+static void reportProcess(const ProcessOptions &options, size_t projects, size_t repeat,
+                          const Measurement &build, const Measurement &prepare, const Measurement &run) {
+    double actions = double(projects) * options.chain;
+    std::printf("{\"benchmark\":\"process\",\"mode\":\"%s\",\"projects\":%zu,\"chain\":%zu,"
+                "\"threads\":%zu,\"arena\":%s,\"repeat\":%zu,\"build_seconds\":%.6f,"
+                "\"build_allocations\":%zu,\"prepare_seconds\":%.6f,\"process_seconds\":%.6f,"
+                "\"ns_per_project\":%.3f,\"ns_per_action\":%.3f,\"process_allocations\":%zu,"
+                "\"peak_rss_kb\":%ld}\n",
+                options.mode.c_str(), projects, options.chain, options.threads, options.arena ? "true" : "false",
+                repeat, build.seconds, build.allocations, prepare.seconds, run.seconds,
+                run.seconds * 1e9 / projects, actions ? run.seconds * 1e9 / actions : 0.0, run.allocations,
+                peakRssKb());
+    std::fflush(stdout);
+}
+
+static void benchRegistry(const ProcessOptions &options, size_t projects) {
+    ChainGenerator generator(options);
+    ProjectRegistry registry;
+    Measurement build = measure([&] {
+        HeapFactory heap;
+        ArenaFactory arena{registry};
+        for (size_t i = 0; i < projects; ++i) {
+            std::string name = "Project " + std::to_string(i);
+            if (options.arena) {
+                auto actions = generator.next(arena);
+                registry.createProject(std::move(name), generator.department(), generator.funded(),
+                                       generator.budget(), actions);
+            } else {
+                auto actions = generator.next(heap);
+                registry.addProject(new GovernmentProject(std::move(name), generator.department(),
+                                                          generator.funded(), generator.budget(), actions));
+            }
+        }
+    });
+    WorkStealingPool pool(options.mode == "parallel" ? options.threads : 1);
+    Measurement prepare = measure([&] {
+        if (options.mode == "compiled") registry.compileAll();
+        if (options.mode == "optimized") registry.optimizeAll();
+        if (options.mode == "native") registry.compileAllNative();
+    });
+    for (size_t r = 0; r < options.repeat; ++r) {
+        Measurement run = measure([&] {
+            if (options.mode == "parallel") {
+                registry.processAllParallel(pool);
+            } else {
+                registry.processAll();
+            }
+        });
+        reportProcess(options, projects, r, build, prepare, run);
+    }
+}
+
+static void benchSharded(const ProcessOptions &options, size_t projects) {
+    const NumaTopology &topology = NumaTopology::system();
+    ShardedRegistry registry(topology, std::max<size_t>(1, options.threads / topology.nodes()));
+    std::vector<ChainGenerator> generators;
+    for (size_t node = 0; node < registry.shardCount(); ++node) {
+        ProcessOptions seeded = options;
+        seeded.seed += node;
+        generators.emplace_back(seeded);
+    }
+    Measurement build = measure([&] {
+        registry.populate(projects, [&](ProjectRegistry &shard, size_t i) {
+            ChainGenerator &generator = generators[i % generators.size()];
+            ArenaFactory arena{shard};
+            auto actions = generator.next(arena);
+            shard.createProject("Project " + std::to_string(i), generator.department(), generator.funded(),
+                                generator.budget(), actions);
+        });
+    });
+    Measurement prepare = measure([] {});
+    for (size_t r = 0; r < options.repeat; ++r) {
+        Measurement run = measure([&] { registry.processAll(); });
+        reportProcess(options, projects, r, build, prepare, run);
+    }
+}
+
+static void benchColumnar(const ProcessOptions &options, size_t projects) {
+    ChainGenerator generator(options);
+    ColumnarRegistry store;
+    Measurement build = measure([&] {
+        HeapFactory heap;
+        for (size_t i = 0; i < projects; ++i) {
+            auto actions = generator.next(heap);
+            store.addProject("Project " + std::to_string(i), generator.department(), generator.funded(),
+                             generator.budget(), actions);
+        }
+    });
+    Measurement prepare = measure([&] {
+        if (options.mode == "batched") store.batchGroupCount();
+    });
+    for (size_t r = 0; r < options.repeat; ++r) {
+        Measurement run = measure([&] {
+            if (options.mode == "batched") {
+                store.processAllBatched();
+            } else {
+                store.processAll();
+            }
+        });
+        reportProcess(options, projects, r, build, prepare, run);
+    }
+}
+
+static void benchSize(const ProcessOptions &options, size_t projects) {
+    if (options.mode == "columnar" || options.mode == "batched") {
+        benchColumnar(options, projects);
+    } else if (options.mode == "sharded") {
+        benchSharded(options, projects);
+    } else {
+        benchRegistry(options, projects);
+    }
+}
+
+static std::vector<double> parseList(std::string_view text) {
+    std::vector<double> values;
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        values.push_back(std::strtod(std::string(text.substr(0, comma)).c_str(), nullptr));
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+    }
+    return values;
+}
+
+static int usage(const char *program) {
+    std::fprintf(stderr,
+                 "usage: %s accessors [reads]\n"
+                 "       %s process [--projects N[,N...]] [--chain L] [--threads T] [--repeat R]\n"
+                 "                  [--mode serial|parallel|sharded|compiled|optimized|native|columnar|batched] [--arena] [--seed S]\n"
+                 "                  [--mix approve,adjust,complete,conditional,transfer,freeze weights]\n",
+                 program, program);
+    return 1;
+}
+
+static int benchProcess(int argc, char **argv) {
+    ProcessOptions options;
+    for (int i = 2; i < argc; ++i) {
+        std::string_view flag = argv[i];
+        if (flag == "--arena") {
+            options.arena = true;
+            continue;
+        }
+        if (i + 1 >= argc) return usage(argv[0]);
+        std::string_view value = argv[++i];
+        if (flag == "--projects") {
+            options.sizes.clear();
+            for (double size : parseList(value)) options.sizes.push_back(static_cast<size_t>(size));
+        } else if (flag == "--chain") {
+            options.chain = std::strtoull(value.data(), nullptr, 10);
+        } else if (flag == "--threads") {
+            options.threads = std::strtoull(value.data(), nullptr, 10);
+        } else if (flag == "--repeat") {
+            options.repeat = std::strtoull(value.data(), nullptr, 10);
+        } else if (flag == "--seed") {
+            options.seed = std::strtoull(value.data(), nullptr, 10);
+        } else if (flag == "--mode") {
+            options.mode = value;
+        } else if (flag == "--mix") {
+            options.mix = parseList(value);
+            if (options.mix.size() != 6) return usage(argv[0]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    bool columnar = options.mode == "columnar" || options.mode == "batched";
+    if (!columnar && options.mode != "serial" && options.mode != "parallel" && options.mode != "compiled" &&
+        options.mode != "optimized" && options.mode != "native" && options.mode != "sharded") {
+        return usage(argv[0]);
+    }
+    for (size_t projects : options.sizes) {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child < 0) {
+            std::perror("fork");
+            return 1;
+        }
+        if (child == 0) {
+            benchSize(options, projects);
+            std::fflush(stdout);
+            std::_Exit(0);
+        }
+        int status = 0;
+        if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::string_view benchmark = argc > 1 ? argv[1] : "";
+    if (benchmark == "accessors") {
+        return benchAccessors(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000);
+    }
+    if (benchmark == "process") {
+        return benchProcess(argc, argv);
+    }
+    return usage(argv[0]);
+}
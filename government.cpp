@@ -1,129 +1,17 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#include <vector>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "government.h"
 #include "test.h"
 
-class GovernmentProject;
-
-class ProjectAction {
-public:
-    virtual void execute(GovernmentProject &project) = 0;
-    virtual ~ProjectAction() = default;
-};
-
-class GovernmentProject {
-    std::string project_name;
-    std::string department;
-    bool is_funded;
-    double budget;
-    bool is_completed;
-    std::vector<ProjectAction*> actions;
-
-public:
-    GovernmentProject(const std::string &name, const std::string &dept,
-                     bool funded, double budget_amount,
-                     const std::vector<ProjectAction*> &acts)
-        : project_name(name), department(dept),
-          is_funded(funded), budget(budget_amount),
-          is_completed(false), actions(acts) {}
-
-    std::string getProjectName() const { return project_name; }
-    std::string getDepartment() const { return department; }
-    bool isFunded() const { return is_funded; }
-    double getBudget() const { return budget; }
-    bool isCompleted() const { return is_completed; }
-
-    void setFunded(bool funded) { is_funded = funded; }
-    void setBudget(double amount) { budget = amount; }
-    void setCompleted(bool completed) { is_completed = completed; }
-    void setDepartment(const std::string &dept) { department = dept; }
-
-    void process() {
-        for (auto *action : actions) {
-            action->execute(*this);
-        }
-    }
-
-    ~GovernmentProject() {
-        for (auto *action : actions) {
-            delete action;
-        }
-    }
-};
-
-class ApproveFunding : public ProjectAction {
-public:
-    void execute(GovernmentProject &project) override {
-        project.setFunded(true);
-    }
-};
-
-class AdjustBudget : public ProjectAction {
-    double adjustment;
-public:
-    AdjustBudget(double adj) : adjustment(adj) {}
-    void execute(GovernmentProject &project) override {
-        project.setBudget(project.getBudget() + adjustment);
-    }
-};
-
-class CompleteProject : public ProjectAction {
-public:
-    void execute(GovernmentProject &project) override {
-        if (project.isFunded()) {
-            project.setCompleted(true);
-        }
-    }
-};
-
-class ConditionalApproval : public ProjectAction {
-    ProjectAction* action;
-    double min_budget;
-public:
-    ConditionalApproval(ProjectAction* act, double budget)
-        : action(act), min_budget(budget) {}
-    void execute(GovernmentProject &project) override {
-        if (project.getBudget() >= min_budget) {
-            action->execute(project);
-        }
-    }
-    ~ConditionalApproval() { delete action; }
-};
-
-class DepartmentTransfer : public ProjectAction {
-    std::string new_department;
-public:
-    DepartmentTransfer(const std::string &dept) : new_department(dept) {}
-    void execute(GovernmentProject &project) override {
-        project.setDepartment(new_department);
-    }
-};
-
-class BudgetFreeze : public ProjectAction {
-public:
-    void execute(GovernmentProject &project) override {
-        project.setBudget(0);
-    }
-};
-
-class ProjectRegistry {
-    std::vector<GovernmentProject*> projects;
-public:
-    void addProject(GovernmentProject *project) { projects.push_back(project); }
-
-    void processAll() {
-        for (auto *project : projects) {
-            project->process();
-        }
-    }
-
-    ~ProjectRegistry() {
-        for (auto *project : projects) {
-            delete project;
-        }
-    }
-};
-
 TEST(GovernmentTest, InfrastructureProjectApproval) {
     ProjectRegistry registry;
     std::vector<ProjectAction*> actions = { new ApproveFunding(), new AdjustBudget(500000) };
@@ -211,6 +99,1291 @@ TEST(GovernmentTest, BudgetFreezeAction) {
     return true;
 }
 
+TEST(GovernmentTest, ParallelProcessingMatchesSerial) {
+    ProjectRegistry serial;
+    ProjectRegistry parallel;
+    std::vector<GovernmentProject*> expected;
+    std::vector<GovernmentProject*> actual;
+    for (int i = 0; i < 10000; ++i) {
+        for (auto *registry : {&serial, &parallel}) {
+            std::vector<ProjectAction*> actions = {
+                new ConditionalApproval(new ApproveFunding(), 50000),
+                new AdjustBudget(i % 7 * 1000),
+                new CompleteProject()
+            };
+            if (i % 11 == 0) actions.push_back(new BudgetFreeze());
+            GovernmentProject* project = new GovernmentProject("Project " + std::to_string(i), "Works", false, i * 10, actions);
+            registry->addProject(project);
+            (registry == &serial ? expected : actual).push_back(project);
+        }
+    }
+    WorkStealingPool pool(4);
+    serial.processAll();
+    parallel.processAllParallel(pool);
+    ASSERT_EQ(parallel.size(), serial.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual[i]->isFunded(), expected[i]->isFunded());
+        ASSERT_EQ(actual[i]->getBudget(), expected[i]->getBudget());
+        ASSERT_EQ(actual[i]->isCompleted(), expected[i]->isCompleted());
+    }
+    return true;
+}
+
+class DoubleBudget : public ProjectAction {
+public:
+    void execute(GovernmentProject &project) override {
+        project.setBudget(project.getBudget() * 2);
+    }
+};
+
+TEST(GovernmentTest, ColumnarRegistryRunsActions) {
+    ColumnarRegistry store;
+    size_t library = store.addProject("Central Library", "Culture", false, 1250000,
+                                      { new ApproveFunding(), new AdjustBudget(750000), new CompleteProject() });
+    size_t highway = store.addProject("Highway Expansion", "Transportation", false, 1200000,
+                                      { new ConditionalApproval(new ApproveFunding(), 5000000),
+                                        new DepartmentTransfer("Urban Development") });
+    size_t museum = store.addProject("National Museum", "Culture", true, 3000000,
+                                     { new DoubleBudget(), new BudgetFreeze() });
+    size_t park = store.addProject("City Park", "Environment", true, 500000, { new DoubleBudget() });
+    store.processAll();
+    ASSERT_TRUE(store.isFunded(library));
+    ASSERT_EQ(store.getBudget(library), 2000000);
+    ASSERT_TRUE(store.isCompleted(library));
+    ASSERT_TRUE(!store.isFunded(highway));
+    ASSERT_EQ(store.getDepartment(highway), "Urban Development");
+    ASSERT_EQ(store.getBudget(museum), 0);
+    ASSERT_EQ(store.getBudget(park), 1000000);
+    ASSERT_EQ(store.getDepartmentId(library), store.getDepartmentId(museum));
+    ASSERT_EQ(store.totalBudget(), 4200000);
+    return true;
+}
+
+TEST(GovernmentTest, CompiledChainsMatchVirtualDispatch) {
+    ProjectRegistry interpreted;
+    ProjectRegistry compiled;
+    std::vector<GovernmentProject*> expected;
+    std::vector<GovernmentProject*> actual;
+    for (int i = 0; i < 64; ++i) {
+        for (auto *registry : {&interpreted, &compiled}) {
+            std::vector<ProjectAction*> actions = {
+                new AdjustBudget(i * 1000),
+                new ConditionalApproval(new ConditionalApproval(new ApproveFunding(), 20000), 40000),
+                new ConditionalApproval(new DoubleBudget(), 30000),
+                new CompleteProject(),
+                new DepartmentTransfer(i % 2 ? "Urban Development" : "Health")
+            };
+            if (i % 5 == 0) actions.push_back(new BudgetFreeze());
+            GovernmentProject* project = new GovernmentProject("Project", "Works", false, 10000, actions);
+            registry->addProject(project);
+            (registry == &interpreted ? expected : actual).push_back(project);
+        }
+    }
+    compiled.compileAll();
+    ASSERT_EQ(actual[0]->getProgram().size(), 9);
+    ASSERT_TRUE(actual[0]->getProgram()[1].op == Opcode::CondGe);
+    ASSERT_EQ(actual[0]->getProgram()[1].operand, 2);
+    interpreted.processAll();
+    compiled.processAll();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual[i]->isFunded(), expected[i]->isFunded());
+        ASSERT_EQ(actual[i]->getBudget(), expected[i]->getBudget());
+        ASSERT_EQ(actual[i]->isCompleted(), expected[i]->isCompleted());
+        ASSERT_EQ(actual[i]->getDepartment(), expected[i]->getDepartment());
+    }
+    return true;
+}
+
+class OverlappingGuards : public ProjectAction {
+public:
+    void execute(GovernmentProject &project) override {
+        ActionProgram program;
+        lower(program);
+        program.run(project);
+    }
+
+    void lower(ActionProgram &program) override {
+        program.emit(Opcode::CondGe, 1, Money::fromCents(10000));
+        program.emit(Opcode::CondGe, 2, Money::fromCents(100000));
+        program.emit(Opcode::Approve);
+        program.emit(Opcode::Adjust, 0, Money::fromCents(500));
+    }
+};
+
+TEST(GovernmentTest, BatchedColumnarMatchesRowByRow) {
+    ColumnarRegistry rows;
+    ColumnarRegistry batched;
+    size_t expected_groups = 0;
+    bool shared_shape_seen[2] = {false, false};
+    for (int i = 0; i < 10000; ++i) {
+        int shape = i < 5000 ? i % 3 : i / 1000 % 3;
+        if (shape == 2) {
+            ++expected_groups;
+        } else if (!shared_shape_seen[shape]) {
+            shared_shape_seen[shape] = true;
+            ++expected_groups;
+        }
+        for (auto *store : {&rows, &batched}) {
+            std::vector<ProjectAction*> actions;
+            if (shape == 0) {
+                actions = { new ApproveFunding(), new AdjustBudget(500000), new CompleteProject() };
+            } else if (shape == 1) {
+                actions = { new ConditionalApproval(new ConditionalApproval(new ApproveFunding(), 3000), 6000),
+                            new CompleteProject(),
+                            new ConditionalApproval(new DepartmentTransfer("Urban Development"), 8000) };
+            } else {
+                actions = { new AdjustBudget(-250), new ConditionalApproval(new DoubleBudget(), 5000),
+                            new ConditionalApproval(new BudgetFreeze(), 9000) };
+            }
+            store->addProject("Project " + std::to_string(i), "Works", i % 7 == 0, i, actions);
+        }
+    }
+    rows.processAll();
+    batched.processAllBatched();
+    ASSERT_EQ(batched.batchGroupCount(), expected_groups);
+    for (size_t row = 0; row < rows.size(); ++row) {
+        ASSERT_EQ(batched.isFunded(row), rows.isFunded(row));
+        ASSERT_EQ(batched.getBudget(row), rows.getBudget(row));
+        ASSERT_EQ(batched.isCompleted(row), rows.isCompleted(row));
+        ASSERT_EQ(batched.getDepartmentId(row), rows.getDepartmentId(row));
+    }
+
+    ActionProgram overlapping;
+    OverlappingGuards().lower(overlapping);
+    ASSERT_TRUE(!overlapping.structured());
+    ASSERT_TRUE(ActionProgram::compile({ new ConditionalApproval(new ConditionalApproval(new ApproveFunding(), 30), 60) }).structured());
+    ColumnarRegistry guarded_rows;
+    ColumnarRegistry guarded_batched;
+    for (int i = 0; i < 400; ++i) {
+        for (auto *store : {&guarded_rows, &guarded_batched}) {
+            store->addProject("Guarded " + std::to_string(i), "Works", false, Money::fromCents(i * 500),
+                              { new OverlappingGuards() });
+        }
+    }
+    guarded_rows.processAll();
+    guarded_batched.processAllBatched();
+    for (size_t row = 0; row < guarded_rows.size(); ++row) {
+        ASSERT_EQ(guarded_batched.isFunded(row), guarded_rows.isFunded(row));
+        ASSERT_EQ(guarded_batched.getBudget(row), guarded_rows.getBudget(row));
+    }
+    ASSERT_TRUE(guarded_rows.isFunded(0) && !guarded_rows.isFunded(100) && guarded_rows.isFunded(300));
+    return true;
+}
+
+TEST(GovernmentTest, BudgetKernelsMatchScalar) {
+    std::vector<int64_t> input;
+    for (int i = 0; i < 1001; ++i) {
+        input.push_back((i * 7919 % 2003 - 1000) * int64_t(100025));
+    }
+    input[17] = 25000000;
+    input[400] = std::numeric_limits<int64_t>::min();
+    const BudgetKernels *scalar = BudgetKernels::available().front();
+    for (const BudgetKernels *kernels : BudgetKernels::available()) {
+        for (size_t count : {0, 3, 64, 67, 1001}) {
+            std::vector<int64_t> expected(input.begin(), input.begin() + count);
+            std::vector<int64_t> actual = expected;
+            ASSERT_TRUE(scalar->add(expected.data(), count, 1234567));
+            ASSERT_TRUE(kernels->add(actual.data(), count, 1234567));
+            ASSERT_TRUE(expected == actual);
+            std::vector<uint64_t> expected_mask(count / 64 + 1, 0);
+            std::vector<uint64_t> actual_mask(count / 64 + 1, 0);
+            scalar->compareGe(expected.data(), count, 250000, expected_mask.data());
+            kernels->compareGe(actual.data(), count, 250000, actual_mask.data());
+            ASSERT_TRUE(expected_mask == actual_mask);
+            if (count > 400) {
+                ASSERT_TRUE(!kernels->add(actual.data(), count, std::numeric_limits<int64_t>::min()));
+                ASSERT_TRUE(expected == actual);
+            }
+            scalar->zero(expected.data(), count);
+            kernels->zero(actual.data(), count);
+            ASSERT_TRUE(expected == actual);
+        }
+    }
+    ColumnarRegistry store;
+    store.addProject("Treasury Bond", "Treasury", true, Money::fromCents(std::numeric_limits<int64_t>::max() - 50),
+                     { new AdjustBudget(1) });
+    bool overflowed = false;
+    try {
+        store.processAllBatched();
+    } catch (const std::overflow_error &) {
+        overflowed = true;
+    }
+    ASSERT_TRUE(overflowed);
+    ASSERT_EQ(store.getBudget(0).cents(), std::numeric_limits<int64_t>::max() - 50);
+    return true;
+}
+
+TEST(GovernmentTest, ArenaBackedRegistry) {
+    ProjectRegistry registry;
+    GovernmentProject* first = nullptr;
+    GovernmentProject* last = nullptr;
+    for (int i = 0; i < 20000; ++i) {
+        std::vector<ProjectAction*> actions = {
+            registry.createAction<ConditionalApproval>(registry.createAction<ApproveFunding>(), 1000),
+            registry.createAction<AdjustBudget>(500),
+            registry.createAction<CompleteProject>()
+        };
+        last = registry.createProject("Arena Project", "Works", false, i, actions);
+        if (!first) first = last;
+    }
+    std::vector<ProjectAction*> heap_actions = { new AdjustBudget(1), new DoubleBudget() };
+    GovernmentProject* heap = new GovernmentProject("Heap Project", "Works", false, 10, heap_actions);
+    registry.addProject(heap);
+    registry.processAll();
+    ASSERT_TRUE(first->isArenaAllocated());
+    ASSERT_TRUE(!heap->isArenaAllocated());
+    ASSERT_TRUE(!first->isFunded());
+    ASSERT_EQ(first->getBudget(), 500);
+    ASSERT_TRUE(last->isCompleted());
+    ASSERT_EQ(heap->getBudget(), 22);
+    ASSERT_EQ(registry.getArena().pendingDestructors(), 2 * 20000);
+    return true;
+}
+
+TEST(GovernmentTest, InlineActionSteps) {
+    ProjectRegistry interpreted;
+    ProjectRegistry compiled;
+    std::vector<GovernmentProject*> expected;
+    std::vector<GovernmentProject*> actual;
+    for (int budget : {500000, 1500000, 2500000, 3500000}) {
+        for (auto *registry : {&interpreted, &compiled}) {
+            std::vector<ActionStep> steps = {
+                AdjustBudget(250000),
+                ConditionalStep{1000000, 3},
+                ApproveFunding(),
+                ConditionalStep{3000000, 1},
+                DepartmentTransfer("Urban Development"),
+                CompleteProject(),
+                CustomStep{new DoubleBudget()},
+                ConditionalStep{6000000, 1},
+                BudgetFreeze()
+            };
+            GovernmentProject* project = new GovernmentProject("Ring Road", "Transportation", false, budget, std::move(steps));
+            registry->addProject(project);
+            (registry == &interpreted ? expected : actual).push_back(project);
+        }
+    }
+    compiled.compileAll();
+    ASSERT_EQ(actual[0]->getProgram()[1].operand, 3);
+    interpreted.processAll();
+    compiled.processAll();
+    ASSERT_TRUE(!expected[0]->isFunded());
+    ASSERT_EQ(expected[0]->getBudget(), 1500000);
+    ASSERT_TRUE(expected[1]->isFunded());
+    ASSERT_EQ(expected[1]->getDepartment(), "Transportation");
+    ASSERT_TRUE(expected[2]->isCompleted());
+    ASSERT_EQ(expected[2]->getBudget(), 5500000);
+    ASSERT_EQ(expected[3]->getDepartment(), "Urban Development");
+    ASSERT_EQ(expected[3]->getBudget(), 0);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual[i]->isFunded(), expected[i]->isFunded());
+        ASSERT_EQ(actual[i]->getBudget(), expected[i]->getBudget());
+        ASSERT_EQ(actual[i]->isCompleted(), expected[i]->isCompleted());
+        ASSERT_EQ(actual[i]->getDepartment(), expected[i]->getDepartment());
+    }
+    return true;
+}
+
+TEST(GovernmentTest, ZeroCopyAccessors) {
+    std::string name = "Regional Water Treatment Upgrade";
+    const char *storage = name.data();
+    GovernmentProject plant(std::move(name), "Environment", false, 4000000, std::vector<ProjectAction*>());
+    ASSERT_TRUE(plant.getProjectName().data() == storage);
+    ASSERT_TRUE(&plant.getProjectName() == &plant.getProjectName());
+    std::string renamed = "Regional Water Treatment Expansion";
+    storage = renamed.data();
+    plant.setProjectName(std::move(renamed));
+    ASSERT_TRUE(plant.getProjectName().data() == storage);
+    std::string_view department = plant.getDepartment();
+    plant.setDepartment(std::string("Public Utilities"));
+    ASSERT_EQ(department, "Environment");
+    ASSERT_EQ(plant.getDepartment(), "Public Utilities");
+    return true;
+}
+
+TEST(GovernmentTest, InternedDepartments) {
+    ProjectRegistry registry;
+    std::vector<ProjectAction*> park_actions = { new DepartmentTransfer("Urban Development") };
+    GovernmentProject* park = new GovernmentProject("City Park", "Environment", true, 500000, park_actions);
+    GovernmentProject* plaza = new GovernmentProject("Civic Plaza", "Urban Development", true, 900000, std::vector<ProjectAction*>());
+    GovernmentProject* forest = new GovernmentProject("Forest Trail", "Environment", true, 100000, std::vector<ProjectAction*>());
+    registry.addProject(park);
+    registry.addProject(plaza);
+    registry.addProject(forest);
+    ASSERT_EQ(park->getDepartmentId(), forest->getDepartmentId());
+    registry.processAll();
+    ASSERT_EQ(park->getDepartmentId(), plaza->getDepartmentId());
+    ASSERT_TRUE(&park->getDepartment() == &plaza->getDepartment());
+    DepartmentDictionary dictionary;
+    for (DepartmentId i = 0; i < 1000; ++i) {
+        ASSERT_EQ(dictionary.intern("Department " + std::to_string(i)), i);
+    }
+    ASSERT_EQ(dictionary.intern("Department 517"), 517);
+    ASSERT_EQ(dictionary.name(999), "Department 999");
+    ASSERT_EQ(dictionary.size(), 1000);
+    return true;
+}
+
+TEST(GovernmentTest, SnapshotRoundTrip) {
+    const std::string path = "government_snapshot_test.bin";
+    {
+        ProjectRegistry registry;
+        std::vector<ProjectAction*> library_actions = {
+            new ApproveFunding(),
+            new ConditionalApproval(new ConditionalApproval(new AdjustBudget(750000), 1000000), 500000),
+            new CompleteProject()
+        };
+        registry.addProject(new GovernmentProject("Central Library", "Culture", false, 1250000, library_actions));
+        std::vector<ActionStep> park_steps = {
+            ConditionalStep{400000, 2}, DepartmentTransfer("Urban Development"), BudgetFreeze()
+        };
+        registry.addProject(new GovernmentProject("City Park", "Environment", true, 500000, std::move(park_steps)));
+        registry.getProject(1)->setCompleted(true);
+        registry.saveSnapshot(path);
+    }
+    ProjectRegistry restored;
+    restored.loadSnapshot(path);
+    ASSERT_EQ(restored.size(), 2);
+    ASSERT_TRUE(!restored.isLoaded(0));
+    ASSERT_EQ(restored.getProject(1)->getProjectName(), "City Park");
+    ASSERT_TRUE(restored.getProject(1)->isCompleted());
+    ASSERT_TRUE(!restored.isLoaded(0));
+    restored.processAll();
+    ASSERT_TRUE(restored.getProject(0)->isCompleted());
+    ASSERT_EQ(restored.getProject(0)->getBudget(), 2000000);
+    ASSERT_EQ(restored.getProject(1)->getDepartment(), "Urban Development");
+    ASSERT_EQ(restored.getProject(1)->getBudget(), 0);
+    restored.saveSnapshot(path);
+    ProjectRegistry reloaded;
+    reloaded.loadSnapshot(path);
+    ASSERT_EQ(reloaded.getProject(0)->getBudget(), 2000000);
+    ASSERT_EQ(reloaded.getProject(1)->getDepartment(), "Urban Development");
+    reloaded.processAll();
+    ASSERT_EQ(reloaded.getProject(0)->getBudget(), 2750000);
+
+    ProjectRegistry custom;
+    std::vector<ProjectAction*> custom_actions = { new DoubleBudget() };
+    custom.addProject(new GovernmentProject("Custom", "Works", false, 1, custom_actions));
+    bool rejected = false;
+    try {
+        custom.saveSnapshot(path);
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+    ProjectRegistry unchanged;
+    unchanged.loadSnapshot(path);
+    ASSERT_EQ(unchanged.size(), 2);
+    std::remove(path.c_str());
+    return true;
+}
+
+TEST(GovernmentTest, ParallelCsvIngest) {
+    const std::string path = "government_csv_test.csv";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "name,department,funded,budget,actions\n";
+        out << "River Bridge,Transportation,0,1000000,approve;adjust:500000\r\n";
+        out << "City Park,Environment,true,500000,transfer:Urban Development\n";
+        out << "Highway Expansion,Transportation,false,1200000,cond:1000000:cond:1100000:approve;complete\n";
+        for (int i = 0; i < 5000; ++i) {
+            out << "Road " << i << ",Works," << i % 2 << "," << i * 10.5 << ",adjust:-0.5;cond:20000:freeze\n";
+        }
+        out << "National Museum,Culture,1,3000000,freeze";
+    }
+    ProjectRegistry registry;
+    WorkStealingPool pool(4);
+    CsvProjectLoader::load(path, registry, pool, 4096);
+    ASSERT_EQ(registry.size(), 5004);
+    registry.processAll();
+    ASSERT_EQ(registry.getProject(0)->getProjectName(), "River Bridge");
+    ASSERT_TRUE(registry.getProject(0)->isFunded());
+    ASSERT_EQ(registry.getProject(0)->getBudget(), 1500000);
+    ASSERT_EQ(registry.getProject(1)->getDepartment(), "Urban Development");
+    ASSERT_TRUE(registry.getProject(2)->isCompleted());
+    for (int i = 0; i < 5000; ++i) {
+        GovernmentProject *road = registry.getProject(3 + i);
+        ASSERT_EQ(road->getProjectName(), "Road " + std::to_string(i));
+        ASSERT_EQ(road->isFunded(), i % 2 == 1);
+        ASSERT_EQ(road->getBudget(), i * 10.5 - 0.5 >= 20000 ? 0 : i * 10.5 - 0.5);
+    }
+    ASSERT_EQ(registry.getProject(5003)->getBudget(), 0);
+    ASSERT_TRUE(registry.getProject(5003)->isArenaAllocated());
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "Broken,Works,maybe,100,approve\n";
+    }
+    ProjectRegistry broken;
+    bool rejected = false;
+    try {
+        CsvProjectLoader::load(path, broken, pool);
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    ASSERT_TRUE(rejected);
+    std::remove(path.c_str());
+    return true;
+}
+
+TEST(GovernmentTest, IncrementalProcessing) {
+    ProjectRegistry registry;
+    std::vector<GovernmentProject*> roads;
+    for (int i = 0; i < 1000; ++i) {
+        std::vector<ProjectAction*> actions = { new AdjustBudget(100) };
+        roads.push_back(new GovernmentProject("Road " + std::to_string(i), "Works", false, 0, actions));
+        registry.addProject(roads.back());
+    }
+    ASSERT_EQ(registry.dirtyCount(), 1000);
+    registry.processAll();
+    ASSERT_EQ(registry.dirtyCount(), 0);
+    roads[10]->setBudget(5000);
+    roads[10]->setFunded(true);
+    roads[20]->setDepartment("Transportation");
+    roads[30]->addAction(new ApproveFunding());
+    std::vector<ProjectAction*> actions = { new AdjustBudget(7) };
+    GovernmentProject* bridge = new GovernmentProject("Bridge", "Works", false, 0, actions);
+    registry.addProject(bridge);
+    ASSERT_EQ(registry.dirtyCount(), 4);
+    registry.processDirty();
+    ASSERT_EQ(registry.dirtyCount(), 0);
+    ASSERT_EQ(roads[10]->getBudget(), 5100);
+    ASSERT_EQ(roads[20]->getBudget(), 200);
+    ASSERT_TRUE(roads[30]->isFunded());
+    ASSERT_EQ(roads[30]->getBudget(), 200);
+    ASSERT_EQ(roads[40]->getBudget(), 100);
+    ASSERT_EQ(bridge->getBudget(), 7);
+    WorkStealingPool pool(2);
+    roads[50]->setCompleted(true);
+    registry.processDirty(pool);
+    ASSERT_EQ(roads[50]->getBudget(), 200);
+    ASSERT_EQ(roads[10]->getBudget(), 5100);
+    return true;
+}
+
+TEST(GovernmentTest, JournalRecovery) {
+    const std::string snapshot_path = "government_journal_test.snapshot";
+    const std::string journal_path = "government_journal_test.log";
+    std::remove(journal_path.c_str());
+    ProjectRegistry live;
+    for (int i = 0; i < 3000; ++i) {
+        std::vector<ProjectAction*> actions = {
+            new ConditionalApproval(new ApproveFunding(), 1000),
+            new AdjustBudget(i % 3 == 0 ? 0 : 250.5),
+            new CompleteProject(),
+            new ConditionalApproval(new DepartmentTransfer(i % 2 ? "Urban Development" : "Rural Affairs"), 2000)
+        };
+        live.addProject(new GovernmentProject("Project " + std::to_string(i), "Works", false, i, actions));
+    }
+    live.saveSnapshot(snapshot_path);
+    {
+        ProjectJournal journal(journal_path, 256);
+        live.setJournal(&journal);
+        WorkStealingPool pool(4);
+        live.processAllParallel(pool);
+        ASSERT_TRUE(journal.commits() >= 2);
+        ASSERT_TRUE(journal.commits() <= 3000 / 256 + 2);
+        live.getProject(7)->setBudget(1);
+        live.processDirty();
+        live.setJournal(nullptr);
+    }
+    {
+        std::ofstream torn(journal_path, std::ios::binary | std::ios::app);
+        torn << "\x18\x00\x00\x00garbage";
+    }
+    ProjectRegistry recovered;
+    recovered.loadSnapshot(snapshot_path);
+    WorkStealingPool pool(3);
+    ASSERT_TRUE(recovered.recoverJournal(journal_path, pool) > 2000);
+    ASSERT_EQ(recovered.dirtyCount(), 0);
+    for (size_t i = 0; i < live.size(); ++i) {
+        GovernmentProject *expected = live.getProject(i);
+        GovernmentProject *actual = recovered.getProject(i);
+        ASSERT_EQ(actual->isFunded(), expected->isFunded());
+        ASSERT_EQ(actual->getBudget(), expected->getBudget());
+        ASSERT_EQ(actual->isCompleted(), expected->isCompleted());
+        ASSERT_EQ(actual->getDepartment(), expected->getDepartment());
+    }
+    std::remove(snapshot_path.c_str());
+    std::remove(journal_path.c_str());
+
+    const std::string failing_path = "government_journal_failure.log";
+    std::remove(failing_path.c_str());
+    std::signal(SIGXFSZ, SIG_IGN);
+    struct rlimit original;
+    ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &original), 0);
+    {
+        ProjectJournal journal(failing_path);
+        ProjectState before = {false, false, Money(), 0};
+        ProjectState after = {true, false, Money(10), 0};
+        journal.record(1, before, after);
+        journal.commit();
+        std::streamoff committed = std::ifstream(failing_path, std::ios::binary | std::ios::ate).tellg();
+        struct rlimit limited = original;
+        limited.rlim_cur = committed + 10;
+        ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limited), 0);
+        journal.record(2, before, after);
+        bool threw = false;
+        try {
+            journal.commit();
+        } catch (const std::runtime_error &) {
+            threw = true;
+        }
+        ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &original), 0);
+        ASSERT_TRUE(threw);
+        journal.record(3, before, after);
+        journal.commit();
+        ASSERT_EQ(journal.commits(), 2);
+    }
+    std::vector<JournalEntry> entries = ProjectJournal::read(failing_path);
+    ASSERT_EQ(entries.size(), 3);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ASSERT_EQ(entries[i].project, i + 1);
+        ASSERT_EQ(entries[i].state.budget, Money(10));
+    }
+    std::signal(SIGXFSZ, SIG_DFL);
+    std::remove(failing_path.c_str());
+    return true;
+}
+
+class BudgetCeiling : public ProjectValidator {
+    Money ceiling;
+public:
+    BudgetCeiling(Money limit) : ceiling(limit) {}
+    bool accept(const GovernmentProject &project, size_t) override {
+        return project.getBudget() <= ceiling;
+    }
+};
+
+class FailingAction : public ProjectAction {
+public:
+    void execute(GovernmentProject &) override {
+        throw std::runtime_error("action failed");
+    }
+};
+
+TEST(GovernmentTest, TransactionalProcessing) {
+    ProjectRegistry registry;
+    std::vector<ProjectAction*> accepted_actions = {
+        new ApproveFunding(), new AdjustBudget(500000), new DepartmentTransfer("Urban Development")
+    };
+    GovernmentProject* accepted = new GovernmentProject("River Bridge", "Transportation", false, 1000000, accepted_actions);
+    std::vector<ProjectAction*> rejected_actions = {
+        new ApproveFunding(), new DepartmentTransfer("Urban Development"), new AdjustBudget(5000000), new BudgetFreeze()
+    };
+    GovernmentProject* rejected = new GovernmentProject("Stadium", "Culture", false, 1000000, rejected_actions);
+    std::vector<ActionStep> rejected_steps = { ApproveFunding(), AdjustBudget(9000000), CompleteProject() };
+    GovernmentProject* rejected_inline = new GovernmentProject("Airport", "Transportation", false, 200000, std::move(rejected_steps));
+    registry.addProject(accepted);
+    registry.addProject(rejected);
+    registry.addProject(rejected_inline);
+    BudgetCeiling ceiling(2000000);
+    ASSERT_EQ(registry.processAllTransactional(ceiling), 2);
+    ASSERT_TRUE(accepted->isFunded());
+    ASSERT_EQ(accepted->getBudget(), 1500000);
+    ASSERT_EQ(accepted->getDepartment(), "Urban Development");
+    ASSERT_TRUE(!rejected->isFunded());
+    ASSERT_EQ(rejected->getBudget(), 1000000);
+    ASSERT_EQ(rejected->getDepartment(), "Culture");
+    ASSERT_TRUE(!rejected_inline->isFunded());
+    ASSERT_EQ(rejected_inline->getBudget(), 200000);
+    ASSERT_EQ(registry.dirtyCount(), 0);
+
+    std::vector<ProjectAction*> failing_actions = { new AdjustBudget(1), new FailingAction() };
+    GovernmentProject failing("Tunnel", "Transportation", false, 10, failing_actions);
+    bool thrown = false;
+    try {
+        failing.processTransaction(ceiling);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    ASSERT_EQ(failing.getBudget(), 10);
+    WorkStealingPool pool(2);
+    ASSERT_EQ(registry.processAllTransactional(ceiling, pool), 2);
+    ASSERT_EQ(accepted->getBudget(), 2000000);
+    return true;
+}
+
+TEST(GovernmentTest, BudgetRangeIndex) {
+    ProjectRegistry registry;
+    for (int i = 0; i < 20000; ++i) {
+        std::vector<ProjectAction*> actions = { new AdjustBudget(i % 2 ? 50 : -25) };
+        if (i % 7 == 0) actions.push_back(new ConditionalApproval(new BudgetFreeze(), 1500000));
+        registry.addProject(new GovernmentProject("Project " + std::to_string(i), "Works", false, i * 100, actions));
+    }
+    registry.enableBudgetIndex();
+    auto matchesScan = [&](Money low, Money high) {
+        std::vector<GovernmentProject*> expected;
+        for (size_t i = 0; i < registry.size(); ++i) {
+            Money budget = registry.getProject(i)->getBudget();
+            if (budget >= low && budget < high) expected.push_back(registry.getProject(i));
+        }
+        std::vector<GovernmentProject*> actual = registry.budgetRange(low, high);
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        return expected == actual && registry.countBudgetRange(low, high) == expected.size();
+    };
+    ASSERT_EQ(registry.countBudgetRange(10000, 20000), 100);
+    ASSERT_TRUE(matchesScan(0, 1));
+    registry.processAll();
+    ASSERT_TRUE(matchesScan(0, 1));
+    ASSERT_TRUE(matchesScan(9950, 20000));
+    ASSERT_TRUE(matchesScan(1400000, 1500000));
+    registry.getProject(3)->setBudget(1499999);
+    registry.getProject(5)->setBudget(-1);
+    ASSERT_TRUE(registry.enableBudgetIndex().pendingUpdates() > 0);
+    ASSERT_TRUE(matchesScan(1490000, 1500000));
+    ASSERT_TRUE(matchesScan(-10, 0));
+    registry.processDirty();
+    ASSERT_TRUE(matchesScan(1490000, 1500050));
+    WorkStealingPool pool(4);
+    registry.processAllParallel(pool);
+    ASSERT_TRUE(matchesScan(0, 3000000));
+    ASSERT_TRUE(matchesScan(2000, 2100));
+    return true;
+}
+
+TEST(GovernmentTest, DepartmentMembershipIndex) {
+    ProjectRegistry registry;
+    const char *departments[] = {"Transportation", "Education", "Health"};
+    for (int i = 0; i < 3000; ++i) {
+        std::vector<ProjectAction*> actions;
+        if (i % 5 == 0) actions.push_back(new ConditionalApproval(new DepartmentTransfer("Health"), 100000));
+        registry.addProject(new GovernmentProject("Project " + std::to_string(i), departments[i % 3], false, i * 100, actions));
+    }
+    registry.enableDepartmentIndex();
+    auto matchesScan = [&](std::string_view department) {
+        std::vector<GovernmentProject*> expected;
+        for (size_t i = 0; i < registry.size(); ++i) {
+            if (registry.getProject(i)->getDepartment() == department) expected.push_back(registry.getProject(i));
+        }
+        std::vector<GovernmentProject*> actual = registry.projectsInDepartment(department);
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        return expected == actual;
+    };
+    ASSERT_EQ(registry.countInDepartment(DepartmentDictionary::global().intern("Education")), 1000);
+    WorkStealingPool pool(3);
+    registry.processAllParallel(pool);
+    for (const char *department : departments) {
+        ASSERT_TRUE(matchesScan(department));
+    }
+    ASSERT_EQ(registry.projectsInDepartment("Transportation").size(), 1000 - 133);
+    registry.getProject(1)->setDepartment("Environment");
+    registry.getProject(2)->setDepartmentId(DepartmentDictionary::global().intern("Transportation"));
+    ASSERT_TRUE(matchesScan("Environment"));
+    ASSERT_TRUE(matchesScan("Education"));
+    ASSERT_TRUE(matchesScan("Health"));
+    ASSERT_TRUE(matchesScan("Transportation"));
+    return true;
+}
+
+TEST(GovernmentTest, DepartmentAggregates) {
+    ProjectRegistry registry;
+    const char *departments[] = {"Transportation", "Education", "Health"};
+    for (int i = 0; i < 5000; ++i) {
+        std::vector<ProjectAction*> actions;
+        if (i % 2 == 0) actions.push_back(new ApproveFunding());
+        if (i % 7 == 0) actions.push_back(new CompleteProject());
+        registry.addProject(new GovernmentProject("Project " + std::to_string(i), departments[i % 3], false, i * 10.5, actions));
+    }
+    WorkStealingPool pool(4);
+    registry.processAllParallel(pool);
+    std::vector<DepartmentAggregate> aggregates = registry.aggregateByDepartment(pool);
+    for (const char *name : departments) {
+        DepartmentId department = DepartmentDictionary::global().intern(name);
+        size_t projects = 0, funded = 0, completed = 0;
+        Money total, funded_total;
+        for (size_t i = 0; i < registry.size(); ++i) {
+            GovernmentProject *project = registry.getProject(i);
+            if (project->getDepartmentId() != department) continue;
+            ++projects;
+            total += project->getBudget();
+            if (project->isFunded()) { ++funded; funded_total += project->getBudget(); }
+            if (project->isCompleted()) ++completed;
+        }
+        ASSERT_TRUE(department < aggregates.size());
+        ASSERT_EQ(aggregates[department].department, department);
+        ASSERT_EQ(aggregates[department].projects, projects);
+        ASSERT_EQ(aggregates[department].funded, funded);
+        ASSERT_EQ(aggregates[department].completed, completed);
+        ASSERT_EQ(aggregates[department].total_budget, total);
+        ASSERT_EQ(aggregates[department].funded_budget, funded_total);
+        ASSERT_EQ(aggregates[department].averageBudget(), total.toDouble() / projects);
+    }
+
+    ProjectRegistry skewed;
+    skewed.addProject(new GovernmentProject("Large", "Treasury", true, 1e16, std::vector<ProjectAction*>()));
+    for (int i = 0; i < 10000; ++i) {
+        skewed.addProject(new GovernmentProject("Small " + std::to_string(i), "Treasury", true, 1.0, std::vector<ProjectAction*>()));
+    }
+    skewed.addProject(new GovernmentProject("Offset", "Treasury", true, -1e16, std::vector<ProjectAction*>()));
+    DepartmentId treasury = DepartmentDictionary::global().intern("Treasury");
+    ASSERT_EQ(skewed.aggregateByDepartment(pool)[treasury].total_budget, 10000);
+    ASSERT_EQ(skewed.aggregateByDepartment()[treasury].total_budget, 10000);
+    ASSERT_EQ(skewed.aggregateByDepartment()[treasury].projects, 10002);
+
+    std::atomic<size_t> stale{0};
+    pool.parallelFor(4, 1, [&](size_t, size_t) {
+        size_t outer = pool.workerIndex();
+        WorkStealingPool inner(2);
+        if (registry.aggregateByDepartment(inner).size() != aggregates.size()) stale.fetch_add(1);
+        if (pool.workerIndex() != outer) stale.fetch_add(1);
+    });
+    ASSERT_EQ(stale.load(), 0);
+    bool threw = false;
+    try {
+        pool.workerIndex();
+    } catch (const std::logic_error &) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    return true;
+}
+
+TEST(GovernmentTest, ExactMoneyArithmetic) {
+    Money total;
+    for (int i = 0; i < 1000; ++i) {
+        total += 0.1;
+    }
+    ASSERT_EQ(total, 100);
+    ASSERT_EQ(Money(19.99).cents(), 1999);
+    ASSERT_EQ(Money(-0.5) * 3, Money::fromCents(-150));
+    Money parsed;
+    ASSERT_TRUE(Money::parse("-1234.5", parsed));
+    ASSERT_EQ(parsed, Money::fromCents(-123450));
+    ASSERT_TRUE(!Money::parse("1.005", parsed));
+    ASSERT_TRUE(!Money::parse("12a", parsed));
+    ASSERT_TRUE(!Money::parse("99999999999999999999", parsed));
+    std::ostringstream printed;
+    printed << Money::fromCents(-5) << ' ' << Money(1500000);
+    ASSERT_EQ(printed.str(), "-0.05 1500000.00");
+    bool overflowed = false;
+    try {
+        Money::fromCents(std::numeric_limits<int64_t>::max()) + Money::fromCents(1);
+    } catch (const std::overflow_error &) {
+        overflowed = true;
+    }
+    ASSERT_TRUE(overflowed);
+    overflowed = false;
+    try {
+        Money(1e30);
+    } catch (const std::overflow_error &) {
+        overflowed = true;
+    }
+    ASSERT_TRUE(overflowed);
+    return true;
+}
+
+class CountedAction : public ProjectAction {
+public:
+    static int live;
+    CountedAction() { ++live; }
+    void execute(GovernmentProject &project) override { project.setBudget(project.getBudget() + 1); }
+    ~CountedAction() { --live; }
+};
+
+int CountedAction::live = 0;
+
+TEST(GovernmentTest, SharedActionChains) {
+    ChainTable &table = ChainTable::global();
+    size_t chains_before = table.size();
+    {
+        ProjectRegistry registry;
+        std::vector<GovernmentProject*> projects;
+        for (int i = 0; i < 3000; ++i) {
+            std::vector<ProjectAction*> actions = { new ApproveFunding(), new AdjustBudget(i % 3 * 100), new CompleteProject() };
+            if (i % 2) actions.push_back(new ConditionalApproval(new BudgetFreeze(), 1000000));
+            projects.push_back(new GovernmentProject("Project " + std::to_string(i), "Works", false, 1000000, actions));
+            registry.addProject(projects.back());
+        }
+        ASSERT_EQ(table.size(), chains_before + 6);
+        ASSERT_TRUE(projects[0]->getChain() == projects[6]->getChain());
+        ASSERT_TRUE(projects[0]->getChain() != projects[1]->getChain());
+        ASSERT_TRUE(projects[0]->getChain()->actions()[0] == sharedAction<ApproveFunding>());
+        ASSERT_TRUE(projects[0]->getChain()->actions()[0]->isShared());
+        ASSERT_TRUE(projects[0]->getChain()->actions()[1] == projects[6]->getChain()->actions()[1]);
+        ASSERT_TRUE(registry.createAction<CompleteProject>() == sharedAction<CompleteProject>());
+
+        projects[0]->addAction(new BudgetFreeze());
+        projects[6]->addAction(new BudgetFreeze());
+        ASSERT_TRUE(projects[0]->getChain() == projects[6]->getChain());
+        ASSERT_EQ(projects[12]->getChain()->size(), 3);
+        projects[12]->addAction(new CountedAction());
+        projects[18]->addAction(new CountedAction());
+        ASSERT_TRUE(projects[12]->getChain() != projects[18]->getChain());
+        ASSERT_EQ(CountedAction::live, 2);
+
+        registry.processAll();
+        ASSERT_TRUE(projects[0]->isCompleted());
+        ASSERT_EQ(projects[0]->getBudget(), 0);
+        ASSERT_EQ(projects[1]->getBudget(), 0);
+        ASSERT_EQ(projects[2]->getBudget(), 1000200);
+        ASSERT_EQ(projects[12]->getBudget(), 1000001);
+        ASSERT_EQ(projects[24]->getBudget(), 1000000);
+    }
+    {
+        ProjectRegistry keeper;
+        GovernmentProject* survivor = nullptr;
+        {
+            ProjectRegistry transient;
+            std::vector<ProjectAction*> arena_actions = { new ConditionalApproval(transient.createAction<AdjustBudget>(5), 0) };
+            transient.addProject(new GovernmentProject("Arena", "Works", false, 100, arena_actions));
+            std::vector<ProjectAction*> heap_actions = { new ConditionalApproval(new AdjustBudget(5), 0) };
+            survivor = new GovernmentProject("Heap", "Works", false, 100, heap_actions);
+            keeper.addProject(survivor);
+            ASSERT_TRUE(transient.getProject(0)->getChain() != survivor->getChain());
+        }
+        keeper.processAll();
+        ASSERT_EQ(survivor->getBudget(), 105);
+    }
+    {
+        using Workflow = Pipeline<ApproveFunding, AdjustBudget, CompleteProject>;
+        std::vector<ProjectAction*> plain = { new ApproveFunding(), new AdjustBudget(250), new CompleteProject() };
+        GovernmentProject first("Plain", "Works", false, 100, plain);
+        std::vector<ProjectAction*> fused = { new Workflow(ApproveFunding(), AdjustBudget(250), CompleteProject()) };
+        GovernmentProject second("Fused", "Works", false, 100, fused);
+        ASSERT_TRUE(first.getChain() != second.getChain());
+        ASSERT_EQ(second.getChain()->size(), 1);
+        ASSERT_TRUE(dynamic_cast<Workflow*>(second.getChain()->actions()[0]) != nullptr);
+        std::vector<ProjectAction*> again = { new Workflow(ApproveFunding(), AdjustBudget(250), CompleteProject()) };
+        GovernmentProject third("Fused Again", "Works", false, 100, again);
+        ASSERT_TRUE(third.getChain() == second.getChain());
+    }
+    ASSERT_EQ(CountedAction::live, 0);
+    ASSERT_EQ(table.size(), chains_before);
+    return true;
+}
+
+TEST(GovernmentTest, ChainOptimizer) {
+    std::vector<ProjectAction*> redundant = {
+        new ApproveFunding(),
+        new AdjustBudget(100),
+        new AdjustBudget(-300),
+        new DepartmentTransfer("Health"),
+        new ConditionalApproval(new ConditionalApproval(new ApproveFunding(), 500), 1000),
+        new AdjustBudget(50),
+        new ApproveFunding(),
+        new DepartmentTransfer("Urban Development"),
+        new AdjustBudget(25),
+        new BudgetFreeze(),
+        new CompleteProject()
+    };
+    GovernmentProject stadium("Stadium", "Culture", false, 2000, redundant);
+    OptimizationReport single = stadium.optimize();
+    ASSERT_EQ(single.instructions_before, 13);
+    ASSERT_EQ(single.instructions_after, 5);
+    ASSERT_EQ(single.redundant_approvals, 2);
+    ASSERT_EQ(single.dead_writes, 2);
+    ASSERT_EQ(single.folded_adjustments, 2);
+    ASSERT_EQ(single.simplified_conditions, 2);
+    ASSERT_TRUE(stadium.getProgram()[2].op == Opcode::Transfer);
+    ASSERT_TRUE(stadium.getProgram()[3].op == Opcode::Freeze);
+    ASSERT_EQ(stadium.getProgram()[3].imm, -30000);
+    stadium.process();
+    ASSERT_TRUE(stadium.isCompleted());
+    ASSERT_EQ(stadium.getBudget(), 0);
+    ASSERT_EQ(stadium.getDepartment(), "Urban Development");
+
+    Money ceiling = Money::fromCents(std::numeric_limits<int64_t>::max() - 10);
+    std::vector<std::vector<ProjectAction*>> overflowing = {
+        { new AdjustBudget(100), new AdjustBudget(-100) },
+        { new AdjustBudget(100), new BudgetFreeze() }
+    };
+    for (auto &actions : overflowing) {
+        GovernmentProject reserve("Reserve", "Treasury", false, ceiling, actions);
+        reserve.optimize();
+        bool threw = false;
+        try {
+            reserve.process();
+        } catch (const std::overflow_error &) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+        ASSERT_EQ(reserve.getBudget(), ceiling);
+    }
+    std::vector<ProjectAction*> reset = { new BudgetFreeze(), new AdjustBudget(100), new AdjustBudget(-30), new BudgetFreeze() };
+    GovernmentProject vault("Vault", "Treasury", false, ceiling, reset);
+    OptimizationReport bounded = vault.optimize();
+    ASSERT_EQ(bounded.folded_adjustments, 1);
+    ASSERT_EQ(vault.getProgram().size(), 1);
+    vault.process();
+    ASSERT_EQ(vault.getBudget(), 0);
+
+    std::vector<std::pair<std::function<std::vector<ProjectAction*>()>, size_t>> shrinking = {
+        {[] { return std::vector<ProjectAction*>{ new AdjustBudget(100), new AdjustBudget(200), new AdjustBudget(300) }; }, 1},
+        {[] { return std::vector<ProjectAction*>{ new AdjustBudget(-100), new ApproveFunding(), new AdjustBudget(-5) }; }, 2},
+        {[] { return std::vector<ProjectAction*>{ new AdjustBudget(100), new BudgetFreeze() }; }, 1},
+        {[] { return std::vector<ProjectAction*>{ new AdjustBudget(100), new AdjustBudget(50), new BudgetFreeze() }; }, 1},
+        {[] { return std::vector<ProjectAction*>{ new AdjustBudget(100), new AdjustBudget(-50), new BudgetFreeze() }; }, 1}
+    };
+    for (auto &pattern : shrinking) {
+        for (Money start : {Money(1000), ceiling - Money(1), Money::fromCents(std::numeric_limits<int64_t>::min() + 10)}) {
+            GovernmentProject plain("Plain", "Treasury", false, start, pattern.first());
+            GovernmentProject folded("Folded", "Treasury", false, start, pattern.first());
+            folded.optimize();
+            ASSERT_EQ(folded.getProgram().size(), pattern.second);
+            bool plain_threw = false;
+            bool folded_threw = false;
+            try {
+                plain.process();
+            } catch (const std::overflow_error &) {
+                plain_threw = true;
+            }
+            try {
+                folded.process();
+            } catch (const std::overflow_error &) {
+                folded_threw = true;
+            }
+            ASSERT_EQ(folded_threw, plain_threw);
+            if (!plain_threw) {
+                ASSERT_EQ(folded.getBudget(), plain.getBudget());
+                ASSERT_EQ(folded.isFunded(), plain.isFunded());
+            }
+        }
+    }
+
+    JitCache overlapping_cache(1);
+    for (Money start : {Money(50), Money(500), Money(5000)}) {
+        auto overlapping = [] {
+            return std::vector<ActionStep>{ ConditionalStep{100, 1}, ConditionalStep{1000, 2}, ApproveFunding(),
+                                            AdjustBudget(5) };
+        };
+        GovernmentProject plain("Plain", "Works", false, start, overlapping());
+        GovernmentProject compiled("Compiled", "Works", false, start, overlapping());
+        GovernmentProject guarded("Optimized", "Works", false, start, overlapping());
+        GovernmentProject warmup("Warmup", "Works", false, start, overlapping());
+        GovernmentProject native("Native", "Works", false, start, overlapping());
+        compiled.compile();
+        OptimizationReport untouched = guarded.optimize();
+        ASSERT_EQ(untouched.removed(), 0);
+        warmup.compileNative(overlapping_cache);
+        warmup.process();
+        native.compileNative(overlapping_cache);
+        for (GovernmentProject *project : {&plain, &compiled, &guarded, &native}) {
+            project->process();
+        }
+        ASSERT_EQ(native.isNative(), JitCompiler::supported());
+        for (GovernmentProject *project : {&compiled, &guarded, &native}) {
+            ASSERT_EQ(project->isFunded(), plain.isFunded());
+            ASSERT_EQ(project->getBudget(), plain.getBudget());
+        }
+        ASSERT_EQ(plain.isFunded(), start != Money(500));
+    }
+
+    ProjectRegistry interpreted;
+    ProjectRegistry optimized;
+    std::vector<GovernmentProject*> expected;
+    std::vector<GovernmentProject*> actual;
+    for (int i = 0; i < 200; ++i) {
+        for (auto *registry : {&interpreted, &optimized}) {
+            std::vector<ProjectAction*> actions = {
+                new AdjustBudget(i % 4 * 1000),
+                new AdjustBudget(-1500),
+                new ConditionalApproval(new ConditionalApproval(new ApproveFunding(), 2000), i * 50),
+                new DepartmentTransfer("Health"),
+                new ConditionalApproval(new DepartmentTransfer("Urban Development"), 4000)
+            };
+            if (i % 3 == 0) actions.push_back(new ConditionalApproval(new DoubleBudget(), 3000));
+            if (i % 5 == 0) actions.push_back(new ApproveFunding());
+            actions.push_back(new AdjustBudget(i % 2 ? 700 : -700));
+            if (i % 7 == 0) actions.push_back(new BudgetFreeze());
+            actions.push_back(new CompleteProject());
+            GovernmentProject* project = new GovernmentProject("Project", "Works", false, i * 40, actions);
+            registry->addProject(project);
+            (registry == &interpreted ? expected : actual).push_back(project);
+        }
+    }
+    OptimizationReport report = optimized.optimizeAll();
+    ASSERT_EQ(report.programs, 200);
+    ASSERT_TRUE(report.removed() > 200);
+    ASSERT_EQ(report.removed(), report.folded_adjustments + report.dead_writes + report.redundant_approvals +
+                                    report.simplified_conditions);
+    ASSERT_TRUE(actual[0]->isOptimized());
+    actual[1]->addAction(new AdjustBudget(5));
+    expected[1]->addAction(new AdjustBudget(5));
+    ASSERT_TRUE(actual[1]->getProgram().size() < actual[1]->lowerProgram().size());
+    interpreted.processAll();
+    optimized.processAll();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual[i]->isFunded(), expected[i]->isFunded());
+        ASSERT_EQ(actual[i]->getBudget(), expected[i]->getBudget());
+        ASSERT_EQ(actual[i]->isCompleted(), expected[i]->isCompleted());
+        ASSERT_EQ(actual[i]->getDepartment(), expected[i]->getDepartment());
+    }
+    return true;
+}
+
+TEST(GovernmentTest, CompileTimePipelines) {
+    using Workflow = Pipeline<ApproveFunding, AdjustBudget, CompleteProject>;
+    using Review = Pipeline<FixedAdjustment<-25000>, FixedCondition<100000000, ApproveFunding>, CompleteProject>;
+    static_assert(ArenaSkipsDestructor<Workflow>::value, "pipelines of built-in actions skip arena cleanup");
+    static_assert(FixedCondition<100000000, ApproveFunding>::threshold == Money::fromCents(100000000), "");
+
+    ProjectRegistry registry;
+    std::vector<ProjectAction*> library_actions = { new Workflow(ApproveFunding(), AdjustBudget(750000), CompleteProject()) };
+    GovernmentProject* library = new GovernmentProject("Central Library", "Culture", false, 1250000, library_actions);
+    registry.addProject(library);
+    size_t destructors = registry.getArena().pendingDestructors();
+    std::vector<ProjectAction*> arena_actions = {
+        registry.createAction<Review>(), registry.createAction<Workflow>(ApproveFunding(), AdjustBudget(1), CompleteProject())
+    };
+    ASSERT_EQ(registry.getArena().pendingDestructors(), destructors);
+    GovernmentProject* museum = registry.createProject("National Museum", "Culture", false, 999000, arena_actions);
+    registry.processAll();
+    ASSERT_TRUE(library->isFunded());
+    ASSERT_EQ(library->getBudget(), 2000000);
+    ASSERT_TRUE(library->isCompleted());
+    ASSERT_TRUE(museum->isFunded());
+    ASSERT_EQ(museum->getBudget(), 998751);
+
+    ActionProgram lowered = library->lowerProgram();
+    ASSERT_EQ(lowered.size(), 3);
+    ASSERT_TRUE(lowered[0].op == Opcode::Approve && lowered[1].op == Opcode::Adjust && lowered[2].op == Opcode::Complete);
+    ASSERT_EQ(museum->lowerProgram().size(), 7);
+
+    ProjectRegistry bulk;
+    for (int i = 0; i < 5000; ++i) {
+        bulk.addProject(new GovernmentProject("Project " + std::to_string(i), "Works", false, i * 400,
+                                              std::vector<ProjectAction*>()));
+    }
+    bulk.enableBudgetIndex();
+    Review review;
+    WorkStealingPool pool(4);
+    bulk.applyAllParallel(review, pool);
+    for (int i = 0; i < 5000; ++i) {
+        GovernmentProject *project = bulk.getProject(i);
+        ASSERT_EQ(project->getBudget(), i * 400 - 250);
+        ASSERT_EQ(project->isFunded(), i * 400 - 250 >= 1000000);
+        ASSERT_EQ(project->isCompleted(), project->isFunded());
+    }
+    ASSERT_EQ(bulk.countBudgetRange(1000000, 3000000), 2499);
+
+    ColumnarRegistry store;
+    for (int i = 0; i < 100; ++i) {
+        store.addProject("Row " + std::to_string(i), "Works", false, i * 20000, std::vector<ProjectAction*>());
+    }
+    store.applyAll(review);
+    ASSERT_TRUE(!store.isFunded(50));
+    ASSERT_TRUE(store.isCompleted(51));
+    ASSERT_EQ(store.getBudget(99), 1979750);
+    return true;
+}
+
+TEST(GovernmentTest, NativeChains) {
+    JitCache cache(2);
+    ProjectRegistry interpreted;
+    ProjectRegistry native;
+    for (int i = 0; i < 60; ++i) {
+        for (auto *registry : {&interpreted, &native}) {
+            std::vector<ActionStep> steps = {
+                AdjustBudget((i % 7 - 3) * 1000.0),
+                ConditionalStep{(i % 5) * 1000, 3},
+                ApproveFunding(),
+                ConditionalStep{4000, 1},
+                DepartmentTransfer(i % 3 ? "Energy" : "Health"),
+                CompleteProject(),
+                ConditionalStep{(i % 11) * 1000, 1},
+                BudgetFreeze()
+            };
+            registry->addProject(new GovernmentProject("Grid " + std::to_string(i), "Works", i % 2, (i % 4) * 1500,
+                                                       std::move(steps)));
+        }
+    }
+    interpreted.compileAll();
+    native.compileAllNative(cache);
+    GovernmentProject* custom = new GovernmentProject("Custom", "Works", false, 0, std::vector<ProjectAction*>{new CountedAction()});
+    native.addProject(custom);
+    custom->compileNative(cache);
+    for (int pass = 0; pass < 3; ++pass) {
+        interpreted.processAll();
+        native.processAll();
+    }
+    for (int i = 0; i < 60; ++i) {
+        ProjectState expected = interpreted.getProject(i)->state();
+        ProjectState actual = native.getProject(i)->state();
+        ASSERT_EQ(actual.budget, expected.budget);
+        ASSERT_EQ(actual.funded, expected.funded);
+        ASSERT_EQ(actual.completed, expected.completed);
+        ASSERT_EQ(actual.department, expected.department);
+        ASSERT_EQ(native.getProject(i)->isNative(), JitCompiler::supported());
+    }
+    ASSERT_TRUE(!custom->isNative());
+    ASSERT_EQ(custom->getBudget(), 3);
+    if (!JitCompiler::supported()) return true;
+    ASSERT_EQ(cache.shapes(), 1);
+    ASSERT_EQ(cache.compiledShapes(), 1);
+
+    Money ceiling = Money::fromCents(std::numeric_limits<int64_t>::max());
+    std::vector<ProjectAction*> reserve_actions = { new ApproveFunding(), new AdjustBudget(Money::fromCents(5)) };
+    GovernmentProject* reserve = new GovernmentProject("Reserve", "Treasury", false, ceiling - Money::fromCents(10),
+                                                       reserve_actions);
+    reserve->compileNative(cache);
+    reserve->process();
+    reserve->process();
+    ASSERT_TRUE(reserve->isNative());
+    bool threw = false;
+    try {
+        reserve->process();
+    } catch (const std::overflow_error &) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQ(reserve->getBudget(), ceiling);
+    ASSERT_TRUE(reserve->isFunded());
+    reserve->addAction(new BudgetFreeze());
+    ASSERT_TRUE(!reserve->isNative());
+    delete reserve;
+
+    JitCache capped(1, 1);
+    GovernmentProject first("First", "Works", false, 0, std::vector<ProjectAction*>{new ApproveFunding()});
+    GovernmentProject second("Second", "Works", true, 0, std::vector<ProjectAction*>{new CompleteProject()});
+    first.compileNative(capped);
+    second.compileNative(capped);
+    first.process();
+    second.process();
+    ASSERT_TRUE(first.isNative());
+    ASSERT_TRUE(!second.isNative());
+    ASSERT_TRUE(second.isCompleted());
+    ASSERT_EQ(capped.shapes(), 1);
+    return true;
+}
+
+TEST(GovernmentTest, ConcurrentIngest) {
+    ProjectRegistry registry;
+    WorkStealingPool pool(2);
+    std::atomic<int> running{4};
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&registry, &running, t] {
+            for (int i = 0; i < 3000; ++i) {
+                std::vector<ProjectAction*> actions = { new AdjustBudget(1) };
+                registry.addProject(new GovernmentProject("Feed " + std::to_string(t) + "-" + std::to_string(i),
+                                                          "Works", false, 0, actions));
+            }
+            running.fetch_sub(1);
+        });
+    }
+    size_t seen = 0;
+    bool stable = true;
+    while (running.load() > 0) {
+        size_t before = registry.size();
+        stable = stable && before >= seen;
+        registry.processAllParallel(pool);
+        seen = before;
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    ASSERT_TRUE(stable);
+    ASSERT_EQ(registry.size(), 12000);
+    ASSERT_EQ(registry.dirtyCount(), 12000 - seen);
+    registry.processDirty();
+    ASSERT_EQ(registry.dirtyCount(), 0);
+    for (size_t i = 0; i < registry.size(); ++i) {
+        GovernmentProject *project = registry.getProject(i);
+        ASSERT_EQ(project->getRegistryIndex(), i);
+        ASSERT_TRUE(project->getBudget() >= 1);
+    }
+
+    registry.addProject(new GovernmentProject("Late", "Works", false, 0, std::vector<ProjectAction*>{ new AdjustBudget(5) }));
+    ASSERT_EQ(registry.dirtyCount(), 1);
+    registry.processDirty();
+    ASSERT_EQ(registry.getProject(12000)->getBudget(), 5);
+    return true;
+}
+
+TEST(GovernmentTest, ConcurrentPublishWatermark) {
+    unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+    for (int round = 0; round < 200; ++round) {
+        ProjectRegistry registry;
+        std::atomic<unsigned> ready{0};
+        std::vector<std::thread> producers;
+        for (unsigned t = 0; t < threads; ++t) {
+            producers.emplace_back([&registry, &ready, threads] {
+                ready.fetch_add(1);
+                while (ready.load() < threads) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < 8; ++i) {
+                    registry.addProject(new GovernmentProject("Burst", "Works", false, 0, std::vector<ProjectAction*>{}));
+                }
+            });
+        }
+        for (auto &producer : producers) {
+            producer.join();
+        }
+        ASSERT_EQ(registry.size(), threads * 8);
+        for (size_t i = 0; i < registry.size(); ++i) {
+            ASSERT_EQ(registry.getProject(i)->getRegistryIndex(), i);
+        }
+    }
+    return true;
+}
+
+TEST(GovernmentTest, NumaShardedRegistry) {
+    std::vector<int> cpus = NumaTopology::parseCpuList("0-3,8,10-11");
+    ASSERT_EQ(cpus.size(), 7);
+    ASSERT_EQ(cpus[4], 8);
+    ASSERT_EQ(cpus[6], 11);
+    ASSERT_TRUE(NumaTopology::system().nodes() >= 1);
+    ASSERT_EQ(NumaTopology({{}, {}}).nodes(), 1);
+
+    NumaTopology topology({{0}, {0}});
+    WorkStealingPool pool(topology, 1);
+    ASSERT_EQ(pool.size(), 2);
+    ASSERT_EQ(pool.nodes(), 2);
+    std::vector<std::atomic<size_t>> visited(2);
+    std::atomic<size_t> misplaced{0};
+    pool.parallelForNodes({3000, 500}, 100, [&](size_t node, size_t begin, size_t end) {
+        if (pool.workerIndex() != node) misplaced.fetch_add(1);
+        visited[node].fetch_add(end - begin);
+    }, false);
+    ASSERT_EQ(misplaced.load(), 0);
+    ASSERT_EQ(visited[0].load(), 3000);
+    ASSERT_EQ(visited[1].load(), 500);
+
+    ShardedRegistry sharded(topology, 2);
+    ASSERT_EQ(sharded.shardCount(), 2);
+#ifdef __linux__
+    cpu_set_t before;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(before), &before), 0);
+#endif
+    sharded.populate(5001, [&misplaced](ProjectRegistry &shard, size_t i) {
+#ifdef __linux__
+        if (sched_getcpu() != 0) misplaced.fetch_add(1);
+#endif
+        std::vector<ProjectAction*> actions = { shard.createAction<AdjustBudget>(static_cast<double>(i)), shard.createAction<ApproveFunding>() };
+        shard.createProject("Shard " + std::to_string(i), "Works", false, 100, actions);
+    });
+    ASSERT_EQ(misplaced.load(), 0);
+#ifdef __linux__
+    cpu_set_t after;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+    ASSERT_TRUE(CPU_EQUAL(&before, &after));
+#endif
+    ASSERT_EQ(sharded.shard(0).size(), 2501);
+    ASSERT_EQ(sharded.shard(1).size(), 2500);
+    sharded.addProject(new GovernmentProject("Extra", "Works", false, 7, std::vector<ProjectAction*>{ new AdjustBudget(1) }));
+    ASSERT_EQ(sharded.size(), 5002);
+    sharded.compileAll();
+    sharded.processAll();
+    sharded.processAll();
+    for (size_t node = 0; node < 2; ++node) {
+        ProjectRegistry &shard = sharded.shard(node);
+        for (size_t i = 0; i < 2500; ++i) {
+            GovernmentProject *project = shard.getProject(i);
+            ASSERT_TRUE(project->isCompiled() && project->isFunded());
+            ASSERT_EQ(project->getBudget(), 100 + 2 * static_cast<int64_t>(i * 2 + node));
+        }
+        ASSERT_EQ(shard.dirtyCount(), 0);
+    }
+    ASSERT_EQ(sharded.shard(0).getProject(2500)->getBudget(), 10100);
+    ASSERT_EQ(sharded.shard(0).getProject(2501)->getBudget(), 9);
+    return true;
+}
+
 int main() {
     RUN_TEST(GovernmentTest, InfrastructureProjectApproval);
     RUN_TEST(GovernmentTest, EducationBudgetCut);
@@ -220,5 +1393,30 @@ int main() {
     RUN_TEST(GovernmentTest, MultiActionProject);
     RUN_TEST(GovernmentTest, DepartmentTransfer);
     RUN_TEST(GovernmentTest, BudgetFreezeAction);
+    RUN_TEST(GovernmentTest, ParallelProcessingMatchesSerial);
+    RUN_TEST(GovernmentTest, ColumnarRegistryRunsActions);
+    RUN_TEST(GovernmentTest, CompiledChainsMatchVirtualDispatch);
+    RUN_TEST(GovernmentTest, BatchedColumnarMatchesRowByRow);
+    RUN_TEST(GovernmentTest, BudgetKernelsMatchScalar);
+    RUN_TEST(GovernmentTest, ArenaBackedRegistry);
+    RUN_TEST(GovernmentTest, InlineActionSteps);
+    RUN_TEST(GovernmentTest, ZeroCopyAccessors);
+    RUN_TEST(GovernmentTest, InternedDepartments);
+    RUN_TEST(GovernmentTest, SnapshotRoundTrip);
+    RUN_TEST(GovernmentTest, ParallelCsvIngest);
+    RUN_TEST(GovernmentTest, IncrementalProcessing);
+    RUN_TEST(GovernmentTest, JournalRecovery);
+    RUN_TEST(GovernmentTest, TransactionalProcessing);
+    RUN_TEST(GovernmentTest, BudgetRangeIndex);
+    RUN_TEST(GovernmentTest, DepartmentMembershipIndex);
+    RUN_TEST(GovernmentTest, DepartmentAggregates);
+    RUN_TEST(GovernmentTest, ExactMoneyArithmetic);
+    RUN_TEST(GovernmentTest, SharedActionChains);
+    RUN_TEST(GovernmentTest, ChainOptimizer);
+    RUN_TEST(GovernmentTest, CompileTimePipelines);
+    RUN_TEST(GovernmentTest, NativeChains);
+    RUN_TEST(GovernmentTest, ConcurrentIngest);
+    RUN_TEST(GovernmentTest, ConcurrentPublishWatermark);
+    RUN_TEST(GovernmentTest, NumaShardedRegistry);
     return 0;
 }
@@ -0,0 +1,3691 @@
+#ifndef GOVERNMENT_H
+#define GOVERNMENT_H
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+#include <type_traits>
+#include <typeinfo>
+#include <limits>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <tuple>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <cstdio>
+#include <ostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GOVERNMENT_X86_KERNELS 1
+#endif
+
+using DepartmentId = uint32_t;
+
+class Money {
+    int64_t amount_cents = 0;
+
+public:
+    [[noreturn]] static void overflow() { throw std::overflow_error("money amount out of range"); }
+
+    static constexpr int64_t kCentsPerUnit = 100;
+
+    constexpr Money() = default;
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    Money(T units) {
+        if (__builtin_mul_overflow(units, kCentsPerUnit, &amount_cents)) overflow();
+    }
+
+    template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    Money(T units) {
+        double scaled = std::round(static_cast<double>(units) * kCentsPerUnit);
+        if (!(scaled >= -0x1p63 && scaled < 0x1p63)) overflow();
+        amount_cents = static_cast<int64_t>(scaled);
+    }
+
+    static constexpr Money fromCents(int64_t cents) {
+        Money money;
+        money.amount_cents = cents;
+        return money;
+    }
+
+    static bool parse(std::string_view text, Money &out) {
+        bool negative = !text.empty() && text[0] == '-';
+        if (!text.empty() && (text[0] == '-' || text[0] == '+')) text.remove_prefix(1);
+        size_t point = text.find('.');
+        std::string_view whole = text.substr(0, point);
+        std::string_view fraction = point == std::string_view::npos ? std::string_view() : text.substr(point + 1);
+        if ((whole.empty() && fraction.empty()) || fraction.size() > 2) return false;
+        int64_t cents = 0;
+        for (std::string_view digits : {whole, fraction}) {
+            for (char c : digits) {
+                if (c < '0' || c > '9') return false;
+                if (__builtin_mul_overflow(cents, 10, &cents) || __builtin_add_overflow(cents, c - '0', &cents)) {
+                    return false;
+                }
+            }
+        }
+        for (size_t i = fraction.size(); i < 2; ++i) {
+            if (__builtin_mul_overflow(cents, 10, &cents)) return false;
+        }
+        out = fromCents(negative ? -cents : cents);
+        return true;
+    }
+
+    constexpr int64_t cents() const { return amount_cents; }
+    double toDouble() const { return static_cast<double>(amount_cents) / kCentsPerUnit; }
+
+    Money &operator+=(Money other) {
+        if (__builtin_add_overflow(amount_cents, other.amount_cents, &amount_cents)) overflow();
+        return *this;
+    }
+
+    Money &operator-=(Money other) {
+        if (__builtin_sub_overflow(amount_cents, other.amount_cents, &amount_cents)) overflow();
+        return *this;
+    }
+
+    friend Money operator+(Money a, Money b) { return a += b; }
+    friend Money operator-(Money a, Money b) { return a -= b; }
+    friend Money operator-(Money a) { return Money() - a; }
+
+    friend Money operator*(Money a, int64_t factor) {
+        Money product;
+        if (__builtin_mul_overflow(a.amount_cents, factor, &product.amount_cents)) overflow();
+        return product;
+    }
+
+    friend constexpr bool operator==(Money a, Money b) { return a.amount_cents == b.amount_cents; }
+    friend constexpr bool operator!=(Money a, Money b) { return a.amount_cents != b.amount_cents; }
+    friend constexpr bool operator<(Money a, Money b) { return a.amount_cents < b.amount_cents; }
+    friend constexpr bool operator<=(Money a, Money b) { return a.amount_cents <= b.amount_cents; }
+    friend constexpr bool operator>(Money a, Money b) { return a.amount_cents > b.amount_cents; }
+    friend constexpr bool operator>=(Money a, Money b) { return a.amount_cents >= b.amount_cents; }
+
+    friend std::ostream &operator<<(std::ostream &out, Money money) {
+        uint64_t magnitude = money.amount_cents < 0 ? 0 - static_cast<uint64_t>(money.amount_cents)
+                                                    : static_cast<uint64_t>(money.amount_cents);
+        char cents[3] = {char('0' + magnitude % 100 / 10), char('0' + magnitude % 10), 0};
+        return out << (money.amount_cents < 0 ? "-" : "") << magnitude / 100 << '.' << cents;
+    }
+};
+
+class DepartmentDictionary {
+    static constexpr size_t kFirstSegment = 64;
+    static constexpr size_t kSegments = 32;
+
+    mutable std::shared_mutex mutex;
+    std::atomic<std::string *> segments[kSegments] = {};
+    std::atomic<size_t> count{0};
+    std::unordered_map<std::string_view, DepartmentId> ids;
+
+    static size_t segmentStart(size_t segment) { return (kFirstSegment << segment) - kFirstSegment; }
+
+    static size_t segmentOf(DepartmentId id) {
+        size_t segment = 0;
+        while (id >= segmentStart(segment + 1)) ++segment;
+        return segment;
+    }
+
+public:
+    static DepartmentDictionary &global() {
+        static DepartmentDictionary dictionary;
+        return dictionary;
+    }
+
+    DepartmentDictionary() = default;
+    DepartmentDictionary(const DepartmentDictionary &) = delete;
+    DepartmentDictionary &operator=(const DepartmentDictionary &) = delete;
+
+    DepartmentId intern(std::string_view name) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = ids.find(name);
+            if (it != ids.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        DepartmentId id = static_cast<DepartmentId>(count.load(std::memory_order_relaxed));
+        size_t segment = segmentOf(id);
+        std::string *names = segments[segment].load(std::memory_order_relaxed);
+        if (!names) {
+            names = new std::string[kFirstSegment << segment];
+            segments[segment].store(names, std::memory_order_release);
+        }
+        std::string &slot = names[id - segmentStart(segment)];
+        slot.assign(name.data(), name.size());
+        ids.emplace(slot, id);
+        count.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    const std::string &name(DepartmentId id) const {
+        size_t segment = segmentOf(id);
+        return segments[segment].load(std::memory_order_acquire)[id - segmentStart(segment)];
+    }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    ~DepartmentDictionary() {
+        for (auto &segment : segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+class BitColumn {
+    std::vector<uint64_t> words;
+    size_t count = 0;
+
+public:
+    size_t size() const { return count; }
+    uint64_t *data() { return words.data(); }
+    const uint64_t *data() const { return words.data(); }
+
+    void push_back(bool value) {
+        if (count % 64 == 0) words.push_back(0);
+        ++count;
+        set(count - 1, value);
+    }
+
+    bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+
+    void set(size_t i, bool value) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        if (value) {
+            words[i / 64] |= bit;
+        } else {
+            words[i / 64] &= ~bit;
+        }
+    }
+
+    void fill(size_t begin, size_t end, bool value) {
+        while (begin < end && begin % 64 != 0) set(begin++, value);
+        for (; begin + 64 <= end; begin += 64) {
+            words[begin / 64] = value ? ~uint64_t(0) : 0;
+        }
+        while (begin < end) set(begin++, value);
+    }
+
+    void extract(size_t begin, size_t length, uint64_t *out) const {
+        size_t shift = begin % 64;
+        for (size_t w = 0; w * 64 < length; ++w) {
+            size_t word = begin / 64 + w;
+            uint64_t bits = words[word] >> shift;
+            if (shift != 0 && word + 1 < words.size()) bits |= words[word + 1] << (64 - shift);
+            size_t valid = std::min<size_t>(64, length - w * 64);
+            out[w] = valid == 64 ? bits : bits & ((uint64_t(1) << valid) - 1);
+        }
+    }
+
+    void setWhere(size_t begin, size_t length, const uint64_t *mask) {
+        size_t shift = begin % 64;
+        for (size_t w = 0; w * 64 < length; ++w) {
+            size_t word = begin / 64 + w;
+            words[word] |= mask[w] << shift;
+            if (shift != 0) {
+                uint64_t spill = mask[w] >> (64 - shift);
+                if (spill) words[word + 1] |= spill;
+            }
+        }
+    }
+};
+
+class ProjectArena;
+
+class ArenaAllocatable {
+    bool arena_allocated = false;
+    friend class ProjectArena;
+public:
+    bool isArenaAllocated() const { return arena_allocated; }
+};
+
+template <typename T>
+struct ArenaSkipsDestructor : std::is_trivially_destructible<T> {};
+
+class ProjectArena {
+    struct Cleanup {
+        void *object;
+        void (*destroy)(void *);
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte *cursor = nullptr;
+    size_t available = 0;
+    size_t reserved = 0;
+    std::vector<Cleanup> cleanups;
+
+public:
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    ProjectArena() = default;
+    ProjectArena(const ProjectArena &) = delete;
+    ProjectArena &operator=(const ProjectArena &) = delete;
+
+    void *allocate(size_t size, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+        if (!cursor || padding + size > available) {
+            size_t block_size = std::max(kBlockSize, size + alignment);
+            blocks.emplace_back(new std::byte[block_size]);
+            cursor = blocks.back().get();
+            available = block_size;
+            reserved += block_size;
+            padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+        }
+        void *result = cursor + padding;
+        cursor += padding + size;
+        available -= padding + size;
+        return result;
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (std::is_base_of_v<ArenaAllocatable, T>) {
+            static_cast<ArenaAllocatable *>(object)->arena_allocated = true;
+        }
+        if constexpr (!ArenaSkipsDestructor<T>::value) {
+            cleanups.push_back({object, [](void *p) { static_cast<T *>(p)->~T(); }});
+        }
+        return object;
+    }
+
+    size_t bytesReserved() const { return reserved; }
+    size_t pendingDestructors() const { return cleanups.size(); }
+
+    void absorb(ProjectArena &other) {
+        for (auto &block : other.blocks) {
+            blocks.push_back(std::move(block));
+        }
+        cleanups.insert(cleanups.end(), other.cleanups.begin(), other.cleanups.end());
+        reserved += other.reserved;
+        other.blocks.clear();
+        other.cleanups.clear();
+        other.cursor = nullptr;
+        other.available = 0;
+        other.reserved = 0;
+    }
+
+    ~ProjectArena() {
+        for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it) {
+            it->destroy(it->object);
+        }
+    }
+};
+
+class GovernmentProject;
+class ColumnarRegistry;
+class ActionProgram;
+
+template <typename T>
+T *sharedAction();
+
+class ProjectAction : public ArenaAllocatable {
+    bool shared = false;
+    template <typename T> friend T *sharedAction();
+public:
+    bool isShared() const { return shared; }
+    bool isOwned() const { return !shared && !isArenaAllocated(); }
+
+    virtual void execute(GovernmentProject &project) = 0;
+    virtual void executeRow(ColumnarRegistry &store, size_t row);
+    virtual void lower(ActionProgram &program);
+    virtual bool shareable() const { return !isArenaAllocated(); }
+    virtual void identify(std::string &key);
+    virtual ~ProjectAction() = default;
+};
+
+class ApproveFunding;
+class AdjustBudget;
+class CompleteProject;
+class DepartmentTransfer;
+class BudgetFreeze;
+
+struct ConditionalStep {
+    Money min_budget;
+    uint32_t guarded;
+};
+
+struct CustomStep {
+    ProjectAction *action;
+};
+
+using ActionStep = std::variant<ApproveFunding, AdjustBudget, CompleteProject, ConditionalStep,
+                                DepartmentTransfer, BudgetFreeze, CustomStep>;
+
+enum class Opcode : uint8_t {
+    Approve,
+    Adjust,
+    Complete,
+    CondGe,
+    Transfer,
+    Freeze,
+    Call
+};
+
+struct Instruction {
+    Opcode op;
+    uint32_t operand;
+    union {
+        int64_t imm;
+        ProjectAction *action;
+    };
+};
+
+class ActionProgram {
+    std::vector<Instruction> code;
+
+public:
+    static ActionProgram compile(const std::vector<ProjectAction*> &actions) {
+        ActionProgram program;
+        for (auto *action : actions) {
+            action->lower(program);
+        }
+        return program;
+    }
+
+    void emit(Opcode op, uint32_t operand = 0, Money imm = Money()) {
+        Instruction instruction{op, operand, {imm.cents()}};
+        code.push_back(instruction);
+    }
+
+    void emitCall(ProjectAction *action) {
+        Instruction instruction{Opcode::Call, 0, {0}};
+        instruction.action = action;
+        code.push_back(instruction);
+    }
+
+    std::string signature() const {
+        std::string key;
+        key.reserve(code.size() * 13);
+        for (const auto &instruction : code) {
+            uint64_t payload = 0;
+            if (instruction.op == Opcode::Call) {
+                payload = reinterpret_cast<uintptr_t>(instruction.action);
+            } else {
+                payload = static_cast<uint64_t>(instruction.imm);
+            }
+            key.push_back(static_cast<char>(instruction.op));
+            key.append(reinterpret_cast<const char *>(&instruction.operand), sizeof(instruction.operand));
+            key.append(reinterpret_cast<const char *>(&payload), sizeof(payload));
+        }
+        return key;
+    }
+
+    void patchOperand(size_t at, uint32_t operand) { code[at].operand = operand; }
+
+    bool structured() const {
+        std::vector<size_t> open;
+        for (size_t pc = 0; pc < code.size(); ++pc) {
+            while (!open.empty() && open.back() <= pc) open.pop_back();
+            if (code[pc].op != Opcode::CondGe) continue;
+            size_t end = std::min(code.size(), pc + 1 + code[pc].operand);
+            if (!open.empty() && end > open.back()) return false;
+            open.push_back(end);
+        }
+        return true;
+    }
+
+    size_t size() const { return code.size(); }
+    bool empty() const { return code.empty(); }
+    const Instruction &operator[](size_t i) const { return code[i]; }
+    const Instruction *data() const { return code.data(); }
+
+    void lowerSteps(std::vector<ActionStep> &steps);
+
+    void run(GovernmentProject &project) const;
+};
+
+inline void ProjectAction::lower(ActionProgram &program) {
+    program.emitCall(this);
+}
+
+inline void ProjectAction::identify(std::string &key) {
+    ActionProgram program;
+    lower(program);
+    std::string lowered = program.signature();
+    uint64_t length = lowered.size();
+    key.append(typeid(*this).name());
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    key.append(lowered);
+}
+
+struct OptimizationReport {
+    size_t programs = 0;
+    size_t instructions_before = 0;
+    size_t instructions_after = 0;
+    size_t folded_adjustments = 0;
+    size_t dead_writes = 0;
+    size_t redundant_approvals = 0;
+    size_t simplified_conditions = 0;
+
+    size_t removed() const { return instructions_before - instructions_after; }
+
+    void merge(const OptimizationReport &other) {
+        programs += other.programs;
+        instructions_before += other.instructions_before;
+        instructions_after += other.instructions_after;
+        folded_adjustments += other.folded_adjustments;
+        dead_writes += other.dead_writes;
+        redundant_approvals += other.redundant_approvals;
+        simplified_conditions += other.simplified_conditions;
+    }
+};
+
+class ChainOptimizer {
+    struct Node {
+        Instruction instruction;
+        std::vector<Node> body;
+    };
+
+    struct Liveness {
+        bool budget_dead = false;
+        bool department_dead = false;
+    };
+
+    struct BudgetRange {
+        int64_t low = std::numeric_limits<int64_t>::min();
+        int64_t high = std::numeric_limits<int64_t>::max();
+
+        bool canAdd(int64_t cents) const {
+            int64_t ignored;
+            return !__builtin_add_overflow(low, cents, &ignored) && !__builtin_add_overflow(high, cents, &ignored);
+        }
+
+        BudgetRange plus(int64_t cents) const {
+            auto saturate = [cents](int64_t value) {
+                int64_t sum;
+                if (!__builtin_add_overflow(value, cents, &sum)) return sum;
+                return cents > 0 ? std::numeric_limits<int64_t>::max() : std::numeric_limits<int64_t>::min();
+            };
+            return {saturate(low), saturate(high)};
+        }
+
+        BudgetRange join(const BudgetRange &other) const {
+            return {std::min(low, other.low), std::max(high, other.high)};
+        }
+    };
+
+    OptimizationReport report;
+    size_t changes = 0;
+
+    static bool foldable(const BudgetRange &before, int64_t first, int64_t second, int64_t &sum) {
+        if (__builtin_add_overflow(first, second, &sum)) return false;
+        if (first == 0 || second == 0 || (first > 0) == (second > 0)) return true;
+        return before.canAdd(first) && before.plus(first).canAdd(second);
+    }
+
+    static std::vector<Node> parse(const ActionProgram &program, size_t begin, size_t end) {
+        std::vector<Node> nodes;
+        for (size_t pc = begin; pc < end; ++pc) {
+            Node node{program[pc], {}};
+            if (node.instruction.op == Opcode::CondGe) {
+                size_t body_end = std::min(end, pc + 1 + node.instruction.operand);
+                node.body = parse(program, pc + 1, body_end);
+                pc = body_end - 1;
+            }
+            nodes.push_back(std::move(node));
+        }
+        return nodes;
+    }
+
+    static void emit(const std::vector<Node> &nodes, ActionProgram &program) {
+        for (const Node &node : nodes) {
+            const Instruction &instruction = node.instruction;
+            if (instruction.op == Opcode::Call) {
+                program.emitCall(instruction.action);
+                continue;
+            }
+            size_t guard = program.size();
+            program.emit(instruction.op, instruction.operand, Money::fromCents(instruction.imm));
+            if (instruction.op == Opcode::CondGe) {
+                emit(node.body, program);
+                program.patchOperand(guard, static_cast<uint32_t>(program.size() - guard - 1));
+            }
+        }
+    }
+
+    void removed(size_t &counter) {
+        ++counter;
+        ++changes;
+    }
+
+    void simplifyConditions(std::vector<Node> &nodes) {
+        std::vector<Node> kept;
+        for (Node &node : nodes) {
+            if (node.instruction.op == Opcode::CondGe) {
+                simplifyConditions(node.body);
+                while (node.body.size() == 1 && node.body[0].instruction.op == Opcode::CondGe) {
+                    Node inner = std::move(node.body[0]);
+                    node.instruction.imm = std::max(node.instruction.imm, inner.instruction.imm);
+                    node.body = std::move(inner.body);
+                    removed(report.simplified_conditions);
+                }
+                if (node.body.empty()) {
+                    removed(report.simplified_conditions);
+                    continue;
+                }
+            }
+            kept.push_back(std::move(node));
+        }
+        nodes.swap(kept);
+    }
+
+    BudgetRange foldAdjustments(std::vector<Node> &nodes, BudgetRange budget) {
+        std::vector<Node> kept;
+        size_t pending = SIZE_MAX;
+        BudgetRange before_pending;
+        for (Node &node : nodes) {
+            switch (node.instruction.op) {
+            case Opcode::Adjust: {
+                int64_t cents = node.instruction.imm;
+                if (cents == 0) {
+                    removed(report.dead_writes);
+                    continue;
+                }
+                if (pending != SIZE_MAX) {
+                    int64_t first = kept[pending].instruction.imm;
+                    int64_t sum;
+                    if (foldable(before_pending, first, cents, sum)) {
+                        kept[pending].instruction.imm = sum;
+                        budget = before_pending.plus(sum);
+                        removed(report.folded_adjustments);
+                        continue;
+                    }
+                }
+                pending = kept.size();
+                before_pending = budget;
+                budget = budget.plus(cents);
+                break;
+            }
+            case Opcode::CondGe: {
+                BudgetRange guarded{std::max(budget.low, node.instruction.imm), budget.high};
+                budget = budget.join(foldAdjustments(node.body, guarded));
+                pending = SIZE_MAX;
+                break;
+            }
+            case Opcode::Freeze:
+                if (pending != SIZE_MAX) {
+                    int64_t first = kept[pending].instruction.imm;
+                    int64_t check = node.instruction.imm;
+                    int64_t sum;
+                    if (check == 0 && before_pending.canAdd(first)) {
+                        kept.erase(kept.begin() + pending);
+                        removed(report.dead_writes);
+                    } else if (foldable(before_pending, first, check, sum)) {
+                        node.instruction.imm = sum;
+                        kept.erase(kept.begin() + pending);
+                        removed(report.folded_adjustments);
+                    }
+                }
+                budget = {0, 0};
+                pending = SIZE_MAX;
+                break;
+            case Opcode::Call:
+                budget = BudgetRange();
+                pending = SIZE_MAX;
+                break;
+            default:
+                break;
+            }
+            kept.push_back(std::move(node));
+        }
+        nodes.swap(kept);
+        return budget;
+    }
+
+    Liveness eliminateDeadWrites(std::vector<Node> &nodes, Liveness live) {
+        std::vector<Node> kept;
+        for (size_t i = nodes.size(); i-- > 0;) {
+            Node &node = nodes[i];
+            switch (node.instruction.op) {
+            case Opcode::Adjust:
+                live.budget_dead = false;
+                break;
+            case Opcode::Freeze:
+                if (live.budget_dead && node.instruction.imm == 0) {
+                    removed(report.dead_writes);
+                    continue;
+                }
+                live.budget_dead = node.instruction.imm == 0;
+                break;
+            case Opcode::Transfer:
+                if (live.department_dead) {
+                    removed(report.dead_writes);
+                    continue;
+                }
+                live.department_dead = true;
+                break;
+            case Opcode::CondGe: {
+                Liveness taken = eliminateDeadWrites(node.body, live);
+                live.department_dead = live.department_dead && taken.department_dead;
+                live.budget_dead = false;
+                break;
+            }
+            case Opcode::Call:
+                live = Liveness();
+                break;
+            default:
+                break;
+            }
+            kept.push_back(std::move(node));
+        }
+        std::reverse(kept.begin(), kept.end());
+        nodes.swap(kept);
+        return live;
+    }
+
+    bool dropRedundantApprovals(std::vector<Node> &nodes, bool funded) {
+        std::vector<Node> kept;
+        for (Node &node : nodes) {
+            switch (node.instruction.op) {
+            case Opcode::Approve:
+                if (funded) {
+                    removed(report.redundant_approvals);
+                    continue;
+                }
+                funded = true;
+                break;
+            case Opcode::CondGe:
+                dropRedundantApprovals(node.body, funded);
+                break;
+            case Opcode::Call:
+                funded = false;
+                break;
+            default:
+                break;
+            }
+            kept.push_back(std::move(node));
+        }
+        nodes.swap(kept);
+        return funded;
+    }
+
+public:
+    static OptimizationReport optimize(ActionProgram &program) {
+        ChainOptimizer optimizer;
+        optimizer.report.programs = 1;
+        optimizer.report.instructions_before = program.size();
+        if (!program.structured()) {
+            optimizer.report.instructions_after = program.size();
+            return optimizer.report;
+        }
+        std::vector<Node> nodes = parse(program, 0, program.size());
+        do {
+            optimizer.changes = 0;
+            optimizer.dropRedundantApprovals(nodes, false);
+            optimizer.eliminateDeadWrites(nodes, Liveness());
+            optimizer.foldAdjustments(nodes, BudgetRange());
+            optimizer.simplifyConditions(nodes);
+        } while (optimizer.changes != 0);
+        ActionProgram optimized;
+        emit(nodes, optimized);
+        program = std::move(optimized);
+        optimizer.report.instructions_after = program.size();
+        return optimizer.report;
+    }
+};
+
+class ActionChain {
+    std::vector<ProjectAction*> chain;
+    size_t first_owned;
+    std::shared_ptr<const ActionChain> prefix;
+
+public:
+    ActionChain(std::vector<ProjectAction*> actions, size_t owned_from, std::shared_ptr<const ActionChain> base)
+        : chain(std::move(actions)), first_owned(owned_from), prefix(std::move(base)) {}
+
+    ActionChain(const ActionChain &) = delete;
+    ActionChain &operator=(const ActionChain &) = delete;
+
+    const std::vector<ProjectAction*> &actions() const { return chain; }
+    size_t size() const { return chain.size(); }
+
+    ~ActionChain() {
+        for (size_t i = first_owned; i < chain.size(); ++i) {
+            if (chain[i]->isOwned()) delete chain[i];
+        }
+    }
+};
+
+class ChainTable {
+    static constexpr size_t kMinSweep = 1024;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const ActionChain>> chains;
+    size_t sweep_at = kMinSweep;
+
+    static ProjectAction *canonical(ProjectAction *action);
+
+    void sweep() {
+        for (auto it = chains.begin(); it != chains.end();) {
+            it = it->second.expired() ? chains.erase(it) : std::next(it);
+        }
+        sweep_at = std::max(kMinSweep, chains.size() * 2);
+    }
+
+    std::shared_ptr<const ActionChain> publish(std::vector<ProjectAction*> actions, size_t owned_from,
+                                               std::shared_ptr<const ActionChain> prefix) {
+        for (size_t i = owned_from; i < actions.size(); ++i) {
+            actions[i] = canonical(actions[i]);
+        }
+        bool shareable = std::all_of(actions.begin(), actions.end(),
+                                     [](const ProjectAction *action) { return action->shareable(); });
+        if (!shareable) return std::make_shared<const ActionChain>(std::move(actions), owned_from, std::move(prefix));
+        std::string key;
+        for (auto *action : actions) {
+            action->identify(key);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<const ActionChain> &slot = chains[key];
+        if (auto existing = slot.lock()) {
+            for (size_t i = owned_from; i < actions.size(); ++i) {
+                if (actions[i]->isOwned()) delete actions[i];
+            }
+            return existing;
+        }
+        auto chain = std::make_shared<const ActionChain>(std::move(actions), owned_from, std::move(prefix));
+        slot = chain;
+        if (chains.size() >= sweep_at) sweep();
+        return chain;
+    }
+
+public:
+    static ChainTable &global() {
+        static ChainTable table;
+        return table;
+    }
+
+    ChainTable() = default;
+    ChainTable(const ChainTable &) = delete;
+    ChainTable &operator=(const ChainTable &) = delete;
+
+    std::shared_ptr<const ActionChain> intern(std::vector<ProjectAction*> actions) {
+        static const std::shared_ptr<const ActionChain> empty =
+            std::make_shared<const ActionChain>(std::vector<ProjectAction*>(), 0, nullptr);
+        if (actions.empty()) return empty;
+        return publish(std::move(actions), 0, nullptr);
+    }
+
+    std::shared_ptr<const ActionChain> extend(std::shared_ptr<const ActionChain> base, ProjectAction *action) {
+        std::vector<ProjectAction*> actions = base->actions();
+        actions.push_back(action);
+        size_t owned_from = base->size();
+        return publish(std::move(actions), owned_from, std::move(base));
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<size_t>(std::count_if(chains.begin(), chains.end(),
+                                                 [](const auto &entry) { return !entry.second.expired(); }));
+    }
+};
+
+struct ProjectState {
+    bool funded;
+    bool completed;
+    Money budget;
+    DepartmentId department;
+};
+
+class NativeChain {
+    void *code = nullptr;
+    size_t length = 0;
+
+public:
+    using Function = int (*)(ProjectState *state, const Instruction *constants);
+
+    NativeChain(const std::vector<uint8_t> &bytes) {
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        length = (bytes.size() + page - 1) / page * page;
+        void *mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) throw std::runtime_error("cannot map native chain");
+        std::memcpy(mapping, bytes.data(), bytes.size());
+        if (::mprotect(mapping, length, PROT_READ | PROT_EXEC) != 0) {
+            ::munmap(mapping, length);
+            throw std::runtime_error("cannot make native chain executable");
+        }
+        __builtin___clear_cache(static_cast<char *>(mapping), static_cast<char *>(mapping) + bytes.size());
+        code = mapping;
+    }
+
+    NativeChain(const NativeChain &) = delete;
+    NativeChain &operator=(const NativeChain &) = delete;
+
+    Function function() const { return reinterpret_cast<Function>(code); }
+    size_t size() const { return length; }
+
+    ~NativeChain() { ::munmap(code, length); }
+};
+
+class JitCompiler {
+    static_assert(std::is_standard_layout_v<ProjectState>, "native chains address ProjectState fields directly");
+    static_assert(std::is_standard_layout_v<Instruction>, "native chains read immediates from the program");
+
+    static constexpr uint8_t kFunded = offsetof(ProjectState, funded);
+    static constexpr uint8_t kCompleted = offsetof(ProjectState, completed);
+    static constexpr uint8_t kBudget = offsetof(ProjectState, budget);
+    static constexpr uint8_t kDepartment = offsetof(ProjectState, department);
+
+    std::vector<uint8_t> code;
+
+    void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+    template <typename T>
+    void immediate(T value) {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        code.insert(code.end(), bytes, bytes + sizeof(T));
+    }
+
+    size_t jump() {
+        immediate<int32_t>(0);
+        return code.size() - 4;
+    }
+
+    void constant(size_t pc, size_t field) {
+        immediate<int32_t>(static_cast<int32_t>(pc * sizeof(Instruction) + field));
+    }
+
+    void patch(size_t at, size_t target) {
+        int32_t displacement = static_cast<int32_t>(target - (at + 4));
+        std::memcpy(&code[at], &displacement, 4);
+    }
+
+public:
+    static bool supported() {
+#if defined(__x86_64__) && defined(__linux__)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static bool compilable(const ActionProgram &program) {
+        for (size_t i = 0; i < program.size(); ++i) {
+            if (program[i].op == Opcode::Call) return false;
+        }
+        return supported();
+    }
+
+    static std::vector<uint8_t> assemble(const ActionProgram &program) {
+        JitCompiler jit;
+        std::vector<size_t> start(program.size() + 1);
+        std::vector<std::pair<size_t, size_t>> guards;
+        std::vector<size_t> overflows;
+        jit.emit({0x48, 0x8B, 0x47, kBudget});
+        for (size_t pc = 0; pc < program.size(); ++pc) {
+            const Instruction &instruction = program[pc];
+            start[pc] = jit.code.size();
+            switch (instruction.op) {
+            case Opcode::Approve:
+                jit.emit({0xC6, 0x47, kFunded, 0x01});
+                break;
+            case Opcode::Adjust:
+                jit.emit({0x48, 0x8B, 0x8E});
+                jit.constant(pc, offsetof(Instruction, imm));
+                jit.emit({0x48, 0x01, 0xC1, 0x0F, 0x80});
+                overflows.push_back(jit.jump());
+                jit.emit({0x48, 0x89, 0xC8});
+                break;
+            case Opcode::Complete:
+                jit.emit({0x0F, 0xB6, 0x4F, kFunded, 0x08, 0x4F, kCompleted});
+                break;
+            case Opcode::CondGe:
+                jit.emit({0x48, 0x3B, 0x86});
+                jit.constant(pc, offsetof(Instruction, imm));
+                jit.emit({0x0F, 0x8C});
+                guards.emplace_back(jit.jump(), std::min(program.size(), pc + 1 + instruction.operand));
+                break;
+            case Opcode::Transfer:
+                jit.emit({0x8B, 0x8E});
+                jit.constant(pc, offsetof(Instruction, operand));
+                jit.emit({0x89, 0x4F, kDepartment});
+                break;
+            case Opcode::Freeze:
+                jit.emit({0x48, 0x8B, 0x8E});
+                jit.constant(pc, offsetof(Instruction, imm));
+                jit.emit({0x48, 0x01, 0xC1, 0x0F, 0x80});
+                overflows.push_back(jit.jump());
+                jit.emit({0x31, 0xC0});
+                break;
+            case Opcode::Call:
+                throw std::logic_error("custom actions cannot be compiled to native code");
+            }
+        }
+        start[program.size()] = jit.code.size();
+        jit.emit({0x48, 0x89, 0x47, kBudget, 0x31, 0xC0, 0xC3});
+        size_t overflow = jit.code.size();
+        jit.emit({0x48, 0x89, 0x47, kBudget, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xC3});
+        for (const auto &guard : guards) {
+            jit.patch(guard.first, start[guard.second]);
+        }
+        for (size_t at : overflows) {
+            jit.patch(at, overflow);
+        }
+        return jit.code;
+    }
+
+    static std::unique_ptr<NativeChain> compile(const ActionProgram &program) {
+        if (!compilable(program)) return nullptr;
+        return std::make_unique<NativeChain>(assemble(program));
+    }
+};
+
+class JitCache {
+public:
+    static constexpr uint32_t kHotThreshold = 256;
+    static constexpr size_t kMaxShapes = 4096;
+
+    class Entry {
+        uint32_t threshold;
+        std::atomic<uint32_t> runs{0};
+        std::atomic<NativeChain::Function> native{nullptr};
+        std::unique_ptr<NativeChain> chain;
+        std::atomic<size_t> &compiled;
+
+    public:
+        Entry(uint32_t hot_threshold, std::atomic<size_t> &compiled_count)
+            : threshold(hot_threshold), compiled(compiled_count) {}
+
+        NativeChain::Function function() const { return native.load(std::memory_order_acquire); }
+
+        void hit(const ActionProgram &program) {
+            if (runs.fetch_add(1, std::memory_order_relaxed) + 1 != threshold) return;
+            try {
+                chain = JitCompiler::compile(program);
+            } catch (const std::runtime_error &) {
+                return;
+            }
+            if (!chain) return;
+            compiled.fetch_add(1, std::memory_order_relaxed);
+            native.store(chain->function(), std::memory_order_release);
+        }
+    };
+
+    static JitCache &global() {
+        static JitCache cache;
+        return cache;
+    }
+
+    explicit JitCache(uint32_t hot_threshold = kHotThreshold, size_t max_shapes = kMaxShapes)
+        : threshold(std::max<uint32_t>(1, hot_threshold)), shape_limit(max_shapes) {}
+
+    static std::string shape(const ActionProgram &program) {
+        std::string key;
+        key.reserve(program.size() * 5);
+        for (size_t pc = 0; pc < program.size(); ++pc) {
+            key.push_back(static_cast<char>(program[pc].op));
+            if (program[pc].op == Opcode::CondGe) {
+                key.append(reinterpret_cast<const char *>(&program[pc].operand), sizeof(program[pc].operand));
+            }
+        }
+        return key;
+    }
+
+    JitCache(const JitCache &) = delete;
+    JitCache &operator=(const JitCache &) = delete;
+
+    Entry *entry(const ActionProgram &program) {
+        if (!JitCompiler::compilable(program)) return nullptr;
+        std::string key = shape(program);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            if (entries.size() >= shape_limit) return nullptr;
+            it = entries.emplace(std::move(key), std::make_unique<Entry>(threshold, compiled)).first;
+        }
+        return it->second.get();
+    }
+
+    size_t shapes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    size_t compiledShapes() const { return compiled.load(std::memory_order_relaxed); }
+
+private:
+    uint32_t threshold;
+    size_t shape_limit;
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    std::atomic<size_t> compiled{0};
+};
+
+class ProjectObserver {
+public:
+    virtual void projectChanged(GovernmentProject &project) = 0;
+    virtual ~ProjectObserver() = default;
+};
+
+class ProjectValidator {
+public:
+    virtual bool accept(const GovernmentProject &project, size_t action_index) = 0;
+    virtual ~ProjectValidator() = default;
+};
+
+class GovernmentProject : public ArenaAllocatable {
+    std::string project_name;
+    DepartmentId department;
+    bool is_funded;
+    Money budget;
+    bool is_completed;
+    std::shared_ptr<const ActionChain> chain;
+    std::vector<ActionStep> steps;
+    ActionProgram program;
+    bool compiled = false;
+    bool optimized = false;
+    JitCache *jit = nullptr;
+    JitCache::Entry *native = nullptr;
+    bool processing = false;
+    bool dirty = false;
+    ProjectObserver *observer = nullptr;
+    size_t registry_index = 0;
+
+    void changed() {
+        if (observer && !processing) observer->projectChanged(*this);
+    }
+
+    void runChain();
+
+public:
+    GovernmentProject(std::string name, std::string_view dept,
+                     bool funded, Money budget_amount,
+                     const std::vector<ProjectAction*> &acts)
+        : project_name(std::move(name)), department(DepartmentDictionary::global().intern(dept)),
+          is_funded(funded), budget(budget_amount),
+          is_completed(false), chain(ChainTable::global().intern(acts)) {}
+
+    GovernmentProject(std::string name, std::string_view dept,
+                     bool funded, Money budget_amount,
+                     std::vector<ActionStep> action_steps)
+        : project_name(std::move(name)), department(DepartmentDictionary::global().intern(dept)),
+          is_funded(funded), budget(budget_amount),
+          is_completed(false), chain(ChainTable::global().intern({})), steps(std::move(action_steps)) {}
+
+    const std::string &getProjectName() const { return project_name; }
+    const std::string &getDepartment() const { return DepartmentDictionary::global().name(department); }
+    DepartmentId getDepartmentId() const { return department; }
+    bool isFunded() const { return is_funded; }
+    Money getBudget() const { return budget; }
+    bool isCompleted() const { return is_completed; }
+
+    void setFunded(bool funded) { is_funded = funded; changed(); }
+    void setBudget(Money amount) { budget = amount; changed(); }
+    void setCompleted(bool completed) { is_completed = completed; changed(); }
+    void setProjectName(std::string name) { project_name = std::move(name); }
+    void setDepartment(std::string_view dept) { department = DepartmentDictionary::global().intern(dept); changed(); }
+    void setDepartmentId(DepartmentId dept) { department = dept; changed(); }
+
+    ProjectState state() const { return {is_funded, is_completed, budget, department}; }
+    void restoreState(const ProjectState &saved) {
+        is_funded = saved.funded;
+        is_completed = saved.completed;
+        budget = saved.budget;
+        department = saved.department;
+    }
+
+    void addAction(ProjectAction *action);
+    void addStep(ActionStep step);
+    const std::shared_ptr<const ActionChain> &getChain() const { return chain; }
+
+    ProjectObserver *getObserver() const { return observer; }
+    void setObserver(ProjectObserver *project_observer) { observer = project_observer; }
+    bool isDirty() const { return dirty; }
+    void setDirty(bool value) { dirty = value; }
+    size_t getRegistryIndex() const { return registry_index; }
+    void setRegistryIndex(size_t index) { registry_index = index; }
+
+    ActionProgram lowerProgram();
+    void compile();
+    OptimizationReport optimize();
+    void compileNative(JitCache &cache = JitCache::global());
+
+    bool isCompiled() const { return compiled; }
+    bool isOptimized() const { return optimized; }
+    bool isNative() const { return native && native->function(); }
+    const ActionProgram &getProgram() const { return program; }
+
+    void process();
+    bool processTransaction(ProjectValidator &validator);
+
+    template <typename Action>
+    void apply(Action &action) {
+        processing = true;
+        try {
+            action.Action::execute(*this);
+        } catch (...) {
+            processing = false;
+            throw;
+        }
+        processing = false;
+    }
+
+    ~GovernmentProject();
+};
+
+inline void ActionProgram::run(GovernmentProject &project) const {
+    const Instruction *pc = code.data();
+    const Instruction *end = pc + code.size();
+    for (; pc != end; ++pc) {
+        switch (pc->op) {
+        case Opcode::Approve:
+            project.setFunded(true);
+            break;
+        case Opcode::Adjust:
+            project.setBudget(project.getBudget() + Money::fromCents(pc->imm));
+            break;
+        case Opcode::Complete:
+            if (project.isFunded()) project.setCompleted(true);
+            break;
+        case Opcode::CondGe:
+            if (project.getBudget() < Money::fromCents(pc->imm)) pc += pc->operand;
+            break;
+        case Opcode::Transfer:
+            project.setDepartmentId(pc->operand);
+            break;
+        case Opcode::Freeze:
+            if (pc->imm != 0) (void)(project.getBudget() + Money::fromCents(pc->imm));
+            project.setBudget(0);
+            break;
+        case Opcode::Call:
+            pc->action->execute(project);
+            break;
+        }
+    }
+}
+
+struct BudgetKernels {
+    const char *name;
+    bool (*add)(int64_t *budgets, size_t count, int64_t adjustment);
+    void (*zero)(int64_t *budgets, size_t count);
+    void (*compareGe)(const int64_t *budgets, size_t count, int64_t threshold, uint64_t *mask);
+
+    static void subtractWrapping(int64_t *budgets, size_t count, int64_t adjustment) {
+        for (size_t i = 0; i < count; ++i) {
+            budgets[i] = static_cast<int64_t>(static_cast<uint64_t>(budgets[i]) - static_cast<uint64_t>(adjustment));
+        }
+    }
+
+    static bool addScalar(int64_t *budgets, size_t count, int64_t adjustment) {
+        for (size_t i = 0; i < count; ++i) {
+            if (__builtin_add_overflow(budgets[i], adjustment, &budgets[i])) {
+                subtractWrapping(budgets, i + 1, adjustment);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void zeroScalar(int64_t *budgets, size_t count) {
+        for (size_t i = 0; i < count; ++i) budgets[i] = 0;
+    }
+
+    static void compareGeScalar(const int64_t *budgets, size_t count, int64_t threshold, uint64_t *mask) {
+        for (size_t w = 0; w * 64 < count; ++w) {
+            uint64_t bits = 0;
+            for (size_t i = w * 64; i < std::min(count, w * 64 + 64); ++i) {
+                bits |= uint64_t(budgets[i] >= threshold) << (i % 64);
+            }
+            mask[w] = bits;
+        }
+    }
+
+#ifdef GOVERNMENT_X86_KERNELS
+    __attribute__((target("avx2"))) static bool addAvx2(int64_t *budgets, size_t count, int64_t adjustment) {
+        __m256i delta = _mm256_set1_epi64x(adjustment);
+        __m256i overflow = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i *lanes = reinterpret_cast<__m256i *>(budgets + i);
+            __m256i before = _mm256_loadu_si256(lanes);
+            __m256i after = _mm256_add_epi64(before, delta);
+            overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(before, after),
+                                                                  _mm256_xor_si256(delta, after)));
+            _mm256_storeu_si256(lanes, after);
+        }
+        bool ok = _mm256_movemask_pd(_mm256_castsi256_pd(overflow)) == 0;
+        if (ok && addScalar(budgets + i, count - i, adjustment)) return true;
+        subtractWrapping(budgets, i, adjustment);
+        return false;
+    }
+
+    __attribute__((target("avx2"))) static void zeroAvx2(int64_t *budgets, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(budgets + i), _mm256_setzero_si256());
+        }
+        zeroScalar(budgets + i, count - i);
+    }
+
+    __attribute__((target("avx2"))) static void compareGeAvx2(const int64_t *budgets, size_t count,
+                                                               int64_t threshold, uint64_t *mask) {
+        __m256i limit = _mm256_set1_epi64x(threshold);
+        size_t full = count / 64 * 64;
+        for (size_t w = 0; w * 64 < full; ++w) {
+            uint64_t bits = 0;
+            for (size_t j = 0; j < 64; j += 4) {
+                __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(budgets + w * 64 + j));
+                __m256i below = _mm256_cmpgt_epi64(limit, values);
+                bits |= uint64_t(~_mm256_movemask_pd(_mm256_castsi256_pd(below)) & 0xF) << j;
+            }
+            mask[w] = bits;
+        }
+        compareGeScalar(budgets + full, count - full, threshold, mask + full / 64);
+    }
+
+    __attribute__((target("avx512f"))) static bool addAvx512(int64_t *budgets, size_t count, int64_t adjustment) {
+        __m512i delta = _mm512_set1_epi64(adjustment);
+        __m512i overflow = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i < count; i += 8) {
+            __mmask8 lanes = count - i >= 8 ? __mmask8(0xFF) : static_cast<__mmask8>((1u << (count - i)) - 1);
+            __m512i before = _mm512_maskz_loadu_epi64(lanes, budgets + i);
+            __m512i after = _mm512_add_epi64(before, delta);
+            overflow = _mm512_or_si512(overflow, _mm512_maskz_and_epi64(lanes, _mm512_xor_si512(before, after),
+                                                                        _mm512_xor_si512(delta, after)));
+            _mm512_mask_storeu_epi64(budgets + i, lanes, after);
+        }
+        if (_mm512_cmplt_epi64_mask(overflow, _mm512_setzero_si512()) == 0) return true;
+        subtractWrapping(budgets, count, adjustment);
+        return false;
+    }
+
+    __attribute__((target("avx512f"))) static void zeroAvx512(int64_t *budgets, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) _mm512_storeu_si512(budgets + i, _mm512_setzero_si512());
+        if (i < count) {
+            _mm512_mask_storeu_epi64(budgets + i, static_cast<__mmask8>((1u << (count - i)) - 1),
+                                     _mm512_setzero_si512());
+        }
+    }
+
+    __attribute__((target("avx512f"))) static void compareGeAvx512(const int64_t *budgets, size_t count,
+                                                                   int64_t threshold, uint64_t *mask) {
+        __m512i limit = _mm512_set1_epi64(threshold);
+        size_t full = count / 64 * 64;
+        for (size_t w = 0; w * 64 < full; ++w) {
+            uint64_t bits = 0;
+            for (size_t j = 0; j < 64; j += 8) {
+                __mmask8 ge = _mm512_cmpge_epi64_mask(_mm512_loadu_si512(budgets + w * 64 + j), limit);
+                bits |= uint64_t(ge) << j;
+            }
+            mask[w] = bits;
+        }
+        compareGeScalar(budgets + full, count - full, threshold, mask + full / 64);
+    }
+#endif
+
+    static std::vector<const BudgetKernels *> available() {
+        static const BudgetKernels scalar{"scalar", addScalar, zeroScalar, compareGeScalar};
+        std::vector<const BudgetKernels *> kernels = {&scalar};
+#ifdef GOVERNMENT_X86_KERNELS
+        static const BudgetKernels avx2{"avx2", addAvx2, zeroAvx2, compareGeAvx2};
+        static const BudgetKernels avx512{"avx512", addAvx512, zeroAvx512, compareGeAvx512};
+        if (__builtin_cpu_supports("avx2")) kernels.push_back(&avx2);
+        if (__builtin_cpu_supports("avx512f")) kernels.push_back(&avx512);
+#endif
+        return kernels;
+    }
+
+    static const BudgetKernels &active() {
+        static const BudgetKernels *best = available().back();
+        return *best;
+    }
+};
+
+class ColumnarRegistry {
+    struct BatchGroup {
+        ActionProgram program;
+        bool structured;
+        std::vector<std::pair<size_t, size_t>> runs;
+        std::vector<size_t> scattered;
+    };
+
+    std::vector<std::string> names;
+    std::vector<DepartmentId> departments;
+    std::vector<int64_t> budgets;
+    BitColumn funded;
+    BitColumn completed;
+    std::vector<std::vector<ProjectAction*>> chains;
+    std::vector<BatchGroup> batch_groups;
+    bool batch_groups_valid = false;
+    std::unique_ptr<ColumnarRegistry> tile;
+
+    static bool gatherable(const ActionProgram &program) {
+        for (size_t pc = 0; pc < program.size(); ++pc) {
+            if (program[pc].op == Opcode::Call) return false;
+        }
+        return true;
+    }
+
+    void buildBatchGroups() {
+        std::unordered_map<std::string, size_t> group_of;
+        batch_groups.clear();
+        for (size_t row = 0; row < chains.size(); ++row) {
+            ActionProgram program = ActionProgram::compile(chains[row]);
+            auto inserted = group_of.emplace(program.signature(), batch_groups.size());
+            if (inserted.second) {
+                bool structured = program.structured();
+                batch_groups.push_back({std::move(program), structured, {}, {}});
+            }
+            auto &runs = batch_groups[inserted.first->second].runs;
+            if (!runs.empty() && runs.back().second == row) {
+                ++runs.back().second;
+            } else {
+                runs.emplace_back(row, row + 1);
+            }
+        }
+        for (auto &group : batch_groups) {
+            if (!group.structured || !gatherable(group.program)) continue;
+            size_t short_rows = 0;
+            for (const auto &run : group.runs) {
+                if (run.second - run.first < kGatherRun) short_rows += run.second - run.first;
+            }
+            if (short_rows < kGatherRun) continue;
+            std::vector<std::pair<size_t, size_t>> long_runs;
+            for (const auto &run : group.runs) {
+                if (run.second - run.first >= kGatherRun) {
+                    long_runs.push_back(run);
+                    continue;
+                }
+                for (size_t row = run.first; row < run.second; ++row) {
+                    group.scattered.push_back(row);
+                }
+            }
+            group.runs.swap(long_runs);
+        }
+        batch_groups_valid = true;
+    }
+
+    void processRow(size_t row) {
+        for (auto *action : chains[row]) {
+            action->executeRow(*this, row);
+        }
+    }
+
+    void runGathered(const ActionProgram &program, const size_t *rows, size_t count) {
+        if (!tile) tile = std::make_unique<ColumnarRegistry>();
+        ColumnarRegistry &gathered = *tile;
+        gathered.budgets.resize(count);
+        gathered.departments.resize(count);
+        gathered.funded = BitColumn();
+        gathered.completed = BitColumn();
+        for (size_t i = 0; i < count; ++i) {
+            gathered.budgets[i] = budgets[rows[i]];
+            gathered.departments[i] = departments[rows[i]];
+            gathered.funded.push_back(funded.test(rows[i]));
+            gathered.completed.push_back(completed.test(rows[i]));
+        }
+        gathered.runBatch(program, 0, program.size(), 0, count, nullptr);
+        for (size_t i = 0; i < count; ++i) {
+            budgets[rows[i]] = gathered.budgets[i];
+            departments[rows[i]] = gathered.departments[i];
+            funded.set(rows[i], gathered.funded.test(i));
+            completed.set(rows[i], gathered.completed.test(i));
+        }
+    }
+
+    void runBatch(const ActionProgram &program, size_t first, size_t last,
+                  size_t begin, size_t end, const uint64_t *mask) {
+        size_t length = end - begin;
+        auto active = [&](size_t row) {
+            return !mask || ((mask[(row - begin) / 64] >> ((row - begin) % 64)) & 1);
+        };
+        for (size_t pc = first; pc < last; ++pc) {
+            const Instruction &instruction = program[pc];
+            switch (instruction.op) {
+            case Opcode::Approve:
+                if (mask) {
+                    funded.setWhere(begin, length, mask);
+                } else {
+                    funded.fill(begin, end, true);
+                }
+                break;
+            case Opcode::Adjust:
+                if (!mask) {
+                    if (!BudgetKernels::active().add(budgets.data() + begin, length, instruction.imm)) {
+                        Money::overflow();
+                    }
+                    break;
+                }
+                for (size_t row = begin; row < end; ++row) {
+                    if (active(row)) setBudget(row, getBudget(row) + Money::fromCents(instruction.imm));
+                }
+                break;
+            case Opcode::Complete: {
+                uint64_t eligible[kBatchTile / 64];
+                funded.extract(begin, length, eligible);
+                if (mask) {
+                    for (size_t w = 0; w * 64 < length; ++w) eligible[w] &= mask[w];
+                }
+                completed.setWhere(begin, length, eligible);
+                break;
+            }
+            case Opcode::CondGe: {
+                uint64_t taken[kBatchTile / 64];
+                BudgetKernels::active().compareGe(budgets.data() + begin, length, instruction.imm, taken);
+                if (mask) {
+                    for (size_t w = 0; w * 64 < length; ++w) taken[w] &= mask[w];
+                }
+                runBatch(program, pc + 1, pc + 1 + instruction.operand, begin, end, taken);
+                pc += instruction.operand;
+                break;
+            }
+            case Opcode::Transfer:
+                for (size_t row = begin; row < end; ++row) {
+                    if (active(row)) departments[row] = instruction.operand;
+                }
+                break;
+            case Opcode::Freeze:
+                if (instruction.imm != 0) {
+                    for (size_t row = begin; row < end; ++row) {
+                        if (active(row)) (void)(getBudget(row) + Money::fromCents(instruction.imm));
+                    }
+                }
+                if (!mask) {
+                    BudgetKernels::active().zero(budgets.data() + begin, length);
+                    break;
+                }
+                for (size_t row = begin; row < end; ++row) {
+                    if (active(row)) budgets[row] = 0;
+                }
+                break;
+            case Opcode::Call:
+                for (size_t row = begin; row < end; ++row) {
+                    if (active(row)) instruction.action->executeRow(*this, row);
+                }
+                break;
+            }
+        }
+    }
+
+public:
+    static constexpr size_t kBatchTile = 4096;
+    static constexpr size_t kGatherRun = 64;
+
+    size_t addProject(std::string name, std::string_view dept,
+                      bool is_funded, Money budget_amount,
+                      const std::vector<ProjectAction*> &acts) {
+        names.push_back(std::move(name));
+        departments.push_back(DepartmentDictionary::global().intern(dept));
+        budgets.push_back(budget_amount.cents());
+        funded.push_back(is_funded);
+        completed.push_back(false);
+        chains.push_back(acts);
+        batch_groups_valid = false;
+        return names.size() - 1;
+    }
+
+    size_t size() const { return names.size(); }
+
+    const std::string &getProjectName(size_t row) const { return names[row]; }
+    const std::string &getDepartment(size_t row) const {
+        return DepartmentDictionary::global().name(departments[row]);
+    }
+    DepartmentId getDepartmentId(size_t row) const { return departments[row]; }
+    bool isFunded(size_t row) const { return funded.test(row); }
+    Money getBudget(size_t row) const { return Money::fromCents(budgets[row]); }
+    bool isCompleted(size_t row) const { return completed.test(row); }
+
+    void setFunded(size_t row, bool value) { funded.set(row, value); }
+    void setBudget(size_t row, Money amount) { budgets[row] = amount.cents(); }
+    void setCompleted(size_t row, bool value) { completed.set(row, value); }
+    void setDepartmentId(size_t row, DepartmentId dept) { departments[row] = dept; }
+    void setDepartment(size_t row, std::string_view dept) {
+        departments[row] = DepartmentDictionary::global().intern(dept);
+    }
+
+    int64_t *budgetCents() { return budgets.data(); }
+    const int64_t *budgetCents() const { return budgets.data(); }
+    BitColumn &fundedColumn() { return funded; }
+    BitColumn &completedColumn() { return completed; }
+
+    void processAll() {
+        for (size_t row = 0; row < chains.size(); ++row) {
+            processRow(row);
+        }
+    }
+
+    void processAllBatched() {
+        if (!batch_groups_valid) buildBatchGroups();
+        for (const auto &group : batch_groups) {
+            if (!group.structured) {
+                for (const auto &run : group.runs) {
+                    for (size_t row = run.first; row < run.second; ++row) {
+                        processRow(row);
+                    }
+                }
+                continue;
+            }
+            for (const auto &run : group.runs) {
+                if (run.second - run.first == 1) {
+                    processRow(run.first);
+                    continue;
+                }
+                for (size_t begin = run.first; begin < run.second; begin += kBatchTile) {
+                    size_t end = std::min(run.second, begin + kBatchTile);
+                    runBatch(group.program, 0, group.program.size(), begin, end, nullptr);
+                }
+            }
+            for (size_t begin = 0; begin < group.scattered.size(); begin += kBatchTile) {
+                runGathered(group.program, group.scattered.data() + begin,
+                            std::min(kBatchTile, group.scattered.size() - begin));
+            }
+        }
+    }
+
+    size_t batchGroupCount() {
+        if (!batch_groups_valid) buildBatchGroups();
+        return batch_groups.size();
+    }
+
+    Money totalBudget() const {
+        Money total;
+        for (int64_t budget : budgets) {
+            total += Money::fromCents(budget);
+        }
+        return total;
+    }
+
+    template <typename Action>
+    void applyAll(Action &action) {
+        for (size_t row = 0; row < size(); ++row) {
+            action.Action::executeRow(*this, row);
+        }
+    }
+
+    void adjustAllBudgets(Money adjustment) {
+        if (!BudgetKernels::active().add(budgets.data(), budgets.size(), adjustment.cents())) Money::overflow();
+    }
+
+    ~ColumnarRegistry() {
+        for (auto &chain : chains) {
+            for (auto *action : chain) {
+                if (action->isOwned()) delete action;
+            }
+        }
+    }
+};
+
+inline void ProjectAction::executeRow(ColumnarRegistry &store, size_t row) {
+    GovernmentProject project(store.getProjectName(row), store.getDepartment(row),
+                              store.isFunded(row), store.getBudget(row), std::vector<ProjectAction*>());
+    project.setCompleted(store.isCompleted(row));
+    project.setDepartmentId(store.getDepartmentId(row));
+    execute(project);
+    store.setFunded(row, project.isFunded());
+    store.setBudget(row, project.getBudget());
+    store.setCompleted(row, project.isCompleted());
+    store.setDepartmentId(row, project.getDepartmentId());
+}
+
+class ApproveFunding : public ProjectAction {
+public:
+    void execute(GovernmentProject &project) override {
+        project.setFunded(true);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        store.setFunded(row, true);
+    }
+    void lower(ActionProgram &program) override { program.emit(Opcode::Approve); }
+};
+
+class AdjustBudget : public ProjectAction {
+    Money adjustment;
+public:
+    AdjustBudget(Money adj) : adjustment(adj) {}
+    void execute(GovernmentProject &project) override {
+        project.setBudget(project.getBudget() + adjustment);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        store.setBudget(row, store.getBudget(row) + adjustment);
+    }
+    void lower(ActionProgram &program) override { program.emit(Opcode::Adjust, 0, adjustment); }
+};
+
+class CompleteProject : public ProjectAction {
+public:
+    void execute(GovernmentProject &project) override {
+        if (project.isFunded()) {
+            project.setCompleted(true);
+        }
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        if (store.isFunded(row)) {
+            store.setCompleted(row, true);
+        }
+    }
+    void lower(ActionProgram &program) override { program.emit(Opcode::Complete); }
+};
+
+class ConditionalApproval : public ProjectAction {
+    ProjectAction* action;
+    Money min_budget;
+public:
+    ConditionalApproval(ProjectAction* act, Money budget)
+        : action(act), min_budget(budget) {}
+    ConditionalApproval(const ConditionalApproval &) = delete;
+    ConditionalApproval &operator=(const ConditionalApproval &) = delete;
+    void execute(GovernmentProject &project) override {
+        if (project.getBudget() >= min_budget) {
+            action->execute(project);
+        }
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        if (store.getBudget(row) >= min_budget) {
+            action->executeRow(store, row);
+        }
+    }
+    void lower(ActionProgram &program) override {
+        size_t guard = program.size();
+        program.emit(Opcode::CondGe, 0, min_budget);
+        action->lower(program);
+        program.patchOperand(guard, static_cast<uint32_t>(program.size() - guard - 1));
+    }
+    bool shareable() const override { return !isArenaAllocated() && action->shareable(); }
+    void identify(std::string &key) override {
+        int64_t threshold = min_budget.cents();
+        key.append(typeid(*this).name());
+        key.push_back('\0');
+        key.append(reinterpret_cast<const char *>(&threshold), sizeof(threshold));
+        action->identify(key);
+    }
+    ~ConditionalApproval() {
+        if (action->isOwned()) delete action;
+    }
+};
+
+class DepartmentTransfer : public ProjectAction {
+    DepartmentId new_department_id;
+public:
+    DepartmentTransfer(std::string_view dept)
+        : new_department_id(DepartmentDictionary::global().intern(dept)) {}
+    explicit DepartmentTransfer(DepartmentId dept) : new_department_id(dept) {}
+    void execute(GovernmentProject &project) override {
+        project.setDepartmentId(new_department_id);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        store.setDepartmentId(row, new_department_id);
+    }
+    void lower(ActionProgram &program) override { program.emit(Opcode::Transfer, new_department_id); }
+};
+
+class BudgetFreeze : public ProjectAction {
+public:
+    void execute(GovernmentProject &project) override {
+        project.setBudget(0);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        store.setBudget(row, 0);
+    }
+    void lower(ActionProgram &program) override { program.emit(Opcode::Freeze); }
+};
+
+template <> struct ArenaSkipsDestructor<ApproveFunding> : std::true_type {};
+template <> struct ArenaSkipsDestructor<AdjustBudget> : std::true_type {};
+template <> struct ArenaSkipsDestructor<CompleteProject> : std::true_type {};
+template <> struct ArenaSkipsDestructor<BudgetFreeze> : std::true_type {};
+template <> struct ArenaSkipsDestructor<DepartmentTransfer> : std::true_type {};
+
+template <typename T>
+struct StatelessAction : std::false_type {};
+
+template <> struct StatelessAction<ApproveFunding> : std::true_type {};
+template <> struct StatelessAction<CompleteProject> : std::true_type {};
+template <> struct StatelessAction<BudgetFreeze> : std::true_type {};
+
+template <typename T>
+T *sharedAction() {
+    static_assert(StatelessAction<T>::value, "only stateless actions can be shared");
+    static T *instance = [] {
+        T *action = new T();
+        action->shared = true;
+        return action;
+    }();
+    return instance;
+}
+
+inline ProjectAction *ChainTable::canonical(ProjectAction *action) {
+    ProjectAction *flyweight = nullptr;
+    if (typeid(*action) == typeid(ApproveFunding)) {
+        flyweight = sharedAction<ApproveFunding>();
+    } else if (typeid(*action) == typeid(CompleteProject)) {
+        flyweight = sharedAction<CompleteProject>();
+    } else if (typeid(*action) == typeid(BudgetFreeze)) {
+        flyweight = sharedAction<BudgetFreeze>();
+    }
+    if (!flyweight || flyweight == action) return action;
+    if (action->isOwned()) delete action;
+    return flyweight;
+}
+
+template <int64_t Cents>
+struct FixedAdjustment {
+    static constexpr Money amount = Money::fromCents(Cents);
+
+    void execute(GovernmentProject &project) const { project.setBudget(project.getBudget() + amount); }
+    void executeRow(ColumnarRegistry &store, size_t row) const { store.setBudget(row, store.getBudget(row) + amount); }
+    void lower(ActionProgram &program) const { program.emit(Opcode::Adjust, 0, amount); }
+};
+
+template <int64_t MinCents, typename Stage>
+struct FixedCondition {
+    static constexpr Money threshold = Money::fromCents(MinCents);
+
+    Stage stage;
+
+    void execute(GovernmentProject &project) {
+        if (project.getBudget() >= threshold) stage.Stage::execute(project);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) {
+        if (store.getBudget(row) >= threshold) stage.Stage::executeRow(store, row);
+    }
+    void lower(ActionProgram &program) {
+        size_t guard = program.size();
+        program.emit(Opcode::CondGe, 0, threshold);
+        stage.Stage::lower(program);
+        program.patchOperand(guard, static_cast<uint32_t>(program.size() - guard - 1));
+    }
+};
+
+template <typename... Stages>
+class Pipeline final : public ProjectAction {
+    std::tuple<Stages...> stages;
+
+    template <typename Stage>
+    static void run(Stage &stage, GovernmentProject &project) { stage.Stage::execute(project); }
+
+    template <typename Stage>
+    static void runRow(Stage &stage, ColumnarRegistry &store, size_t row) { stage.Stage::executeRow(store, row); }
+
+    template <typename Stage>
+    static void lowerStage(Stage &stage, ActionProgram &program) { stage.Stage::lower(program); }
+
+public:
+    Pipeline() = default;
+    explicit Pipeline(Stages... stage_args) : stages(std::move(stage_args)...) {}
+
+    void execute(GovernmentProject &project) override {
+        std::apply([&](auto &...stage) { (run(stage, project), ...); }, stages);
+    }
+    void executeRow(ColumnarRegistry &store, size_t row) override {
+        std::apply([&](auto &...stage) { (runRow(stage, store, row), ...); }, stages);
+    }
+    void lower(ActionProgram &program) override {
+        std::apply([&](auto &...stage) { (lowerStage(stage, program), ...); }, stages);
+    }
+};
+
+template <int64_t MinCents, typename Stage>
+struct ArenaSkipsDestructor<FixedCondition<MinCents, Stage>> : ArenaSkipsDestructor<Stage> {};
+
+template <typename... Stages>
+struct ArenaSkipsDestructor<Pipeline<Stages...>> : std::conjunction<ArenaSkipsDestructor<Stages>...> {};
+
+struct StepExecutor {
+    GovernmentProject &project;
+
+    template <typename Action>
+    uint32_t operator()(Action &action) const {
+        action.Action::execute(project);
+        return 0;
+    }
+
+    uint32_t operator()(ConditionalStep &step) const {
+        return project.getBudget() >= step.min_budget ? 0 : step.guarded;
+    }
+
+    uint32_t operator()(CustomStep &step) const {
+        step.action->execute(project);
+        return 0;
+    }
+};
+
+struct StepLowering {
+    ActionProgram &program;
+
+    template <typename Action>
+    void operator()(Action &action) const { action.Action::lower(program); }
+
+    void operator()(ConditionalStep &step) const { program.emit(Opcode::CondGe, 0, step.min_budget); }
+
+    void operator()(CustomStep &step) const { step.action->lower(program); }
+};
+
+inline void ActionProgram::lowerSteps(std::vector<ActionStep> &steps) {
+    std::vector<size_t> start(steps.size() + 1);
+    for (size_t i = 0; i < steps.size(); ++i) {
+        start[i] = code.size();
+        std::visit(StepLowering{*this}, steps[i]);
+    }
+    start[steps.size()] = code.size();
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (auto *guard = std::get_if<ConditionalStep>(&steps[i])) {
+            size_t end = std::min(steps.size(), i + 1 + guard->guarded);
+            patchOperand(start[i], static_cast<uint32_t>(start[end] - start[i] - 1));
+        }
+    }
+}
+
+inline ActionProgram GovernmentProject::lowerProgram() {
+    ActionProgram lowered = ActionProgram::compile(chain->actions());
+    lowered.lowerSteps(steps);
+    return lowered;
+}
+
+inline void GovernmentProject::compile() {
+    program = lowerProgram();
+    if (optimized) ChainOptimizer::optimize(program);
+    compiled = true;
+    native = jit ? jit->entry(program) : nullptr;
+}
+
+inline void GovernmentProject::compileNative(JitCache &cache) {
+    jit = &cache;
+    compile();
+}
+
+inline OptimizationReport GovernmentProject::optimize() {
+    program = lowerProgram();
+    OptimizationReport report = ChainOptimizer::optimize(program);
+    compiled = true;
+    optimized = true;
+    return report;
+}
+
+inline void GovernmentProject::runChain() {
+    if (compiled) {
+        if (native) {
+            if (NativeChain::Function function = native->function()) {
+                ProjectState current = state();
+                int status = function(&current, program.data());
+                restoreState(current);
+                if (status != 0) Money::overflow();
+                return;
+            }
+            native->hit(program);
+        }
+        program.run(*this);
+        return;
+    }
+    for (auto *action : chain->actions()) {
+        action->execute(*this);
+    }
+    StepExecutor executor{*this};
+    for (size_t i = 0; i < steps.size(); ++i) {
+        i += std::visit(executor, steps[i]);
+    }
+}
+
+inline void GovernmentProject::process() {
+    processing = true;
+    try {
+        runChain();
+    } catch (...) {
+        processing = false;
+        throw;
+    }
+    processing = false;
+}
+
+inline bool GovernmentProject::processTransaction(ProjectValidator &validator) {
+    ProjectState undo = state();
+    processing = true;
+    bool committed = true;
+    try {
+        size_t index = 0;
+        for (auto *action : chain->actions()) {
+            action->execute(*this);
+            if (!validator.accept(*this, index++)) {
+                committed = false;
+                break;
+            }
+        }
+        StepExecutor executor{*this};
+        for (size_t i = 0; committed && i < steps.size(); ++i) {
+            size_t skipped = std::visit(executor, steps[i]);
+            if (!validator.accept(*this, index++)) committed = false;
+            i += skipped;
+        }
+    } catch (...) {
+        restoreState(undo);
+        processing = false;
+        throw;
+    }
+    if (!committed) restoreState(undo);
+    processing = false;
+    return committed;
+}
+
+inline void GovernmentProject::addAction(ProjectAction *action) {
+    chain = ChainTable::global().extend(chain, action);
+    if (compiled) compile();
+    changed();
+}
+
+inline void GovernmentProject::addStep(ActionStep step) {
+    steps.push_back(std::move(step));
+    if (compiled) compile();
+    changed();
+}
+
+inline GovernmentProject::~GovernmentProject() {
+    for (auto &step : steps) {
+        if (auto *custom = std::get_if<CustomStep>(&step)) {
+            if (custom->action->isOwned()) delete custom->action;
+        }
+    }
+}
+
+class NumaTopology {
+    std::vector<std::vector<int>> node_cpus;
+
+    static std::string readLine(const std::string &path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+public:
+    explicit NumaTopology(std::vector<std::vector<int>> cpus) : node_cpus(std::move(cpus)) {
+        node_cpus.erase(std::remove_if(node_cpus.begin(), node_cpus.end(),
+                                       [](const std::vector<int> &node) { return node.empty(); }),
+                        node_cpus.end());
+        if (node_cpus.empty()) node_cpus.push_back({0});
+    }
+
+    static std::vector<int> parseCpuList(std::string_view list) {
+        std::vector<int> cpus;
+        while (!list.empty()) {
+            size_t comma = list.find(',');
+            std::string_view range = list.substr(0, comma);
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(std::string(range.substr(0, dash)));
+            int last = dash == std::string_view::npos ? first : std::stoi(std::string(range.substr(dash + 1)));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    static NumaTopology detect() {
+        std::vector<int> allowed;
+#ifdef __linux__
+        cpu_set_t mask;
+        if (::sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &mask)) allowed.push_back(cpu);
+            }
+        }
+#endif
+        if (allowed.empty()) {
+            for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+                allowed.push_back(static_cast<int>(cpu));
+            }
+        }
+        std::vector<std::vector<int>> nodes;
+        for (int node : parseCpuList(readLine("/sys/devices/system/node/online"))) {
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) cpus.push_back(cpu);
+            }
+            nodes.push_back(std::move(cpus));
+        }
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [](const std::vector<int> &node) { return node.empty(); }),
+                    nodes.end());
+        if (nodes.empty()) nodes.push_back(allowed);
+        return NumaTopology(std::move(nodes));
+    }
+
+    static const NumaTopology &system() {
+        static const NumaTopology topology = detect();
+        return topology;
+    }
+
+    static bool pin(int cpu) {
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        return ::sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    class ScopedPin {
+#ifdef __linux__
+        cpu_set_t previous;
+#endif
+        bool pinned = false;
+
+    public:
+        explicit ScopedPin(int cpu) {
+#ifdef __linux__
+            pinned = cpu >= 0 && ::sched_getaffinity(0, sizeof(previous), &previous) == 0 && pin(cpu);
+#else
+            (void)cpu;
+#endif
+        }
+
+        ScopedPin(const ScopedPin &) = delete;
+        ScopedPin &operator=(const ScopedPin &) = delete;
+
+        ~ScopedPin() {
+#ifdef __linux__
+            if (pinned) ::sched_setaffinity(0, sizeof(previous), &previous);
+#endif
+        }
+    };
+
+    size_t nodes() const { return node_cpus.size(); }
+    const std::vector<int> &cpus(size_t node) const { return node_cpus[node]; }
+
+    size_t cpuCount() const {
+        size_t count = 0;
+        for (const auto &node : node_cpus) {
+            count += node.size();
+        }
+        return count;
+    }
+};
+
+class WorkStealingPool {
+    using Body = std::function<void(size_t, size_t)>;
+
+    struct Task {
+        size_t begin;
+        size_t end;
+        const Body *body;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        size_t node = 0;
+        int cpu = -1;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    size_t generation = 0;
+    bool stopping = false;
+    std::atomic<bool> cross_node{true};
+    size_t node_count = 1;
+    std::atomic<size_t> remaining{0};
+    std::exception_ptr failure;
+
+    struct CurrentWorker {
+        const WorkStealingPool *pool;
+        size_t index;
+    };
+
+    static CurrentWorker &currentWorker() {
+        thread_local CurrentWorker worker = {nullptr, 0};
+        return worker;
+    }
+
+    bool popLocal(size_t self, Task &task) {
+        Worker &worker = *workers[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) return false;
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(size_t self, Task &task, bool remote) {
+        size_t node = workers[self]->node;
+        for (size_t i = 1; i < workers.size(); ++i) {
+            Worker &victim = *workers[(self + i) % workers.size()];
+            if ((victim.node != node) != remote) continue;
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void runTasks(size_t self) {
+        CurrentWorker outer = currentWorker();
+        currentWorker() = {this, self};
+        Task task;
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            if (!popLocal(self, task) && !steal(self, task, false) && !(cross_node.load(std::memory_order_relaxed) && steal(self, task, true))) {
+                std::this_thread::yield();
+                continue;
+            }
+            try {
+                (*task.body)(task.begin, task.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failure) failure = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        currentWorker() = outer;
+    }
+
+    void workerLoop(size_t self) {
+        if (workers[self]->cpu >= 0) NumaTopology::pin(workers[self]->cpu);
+        size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            runTasks(self);
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t thread_count = std::thread::hardware_concurrency()) {
+        if (thread_count == 0) thread_count = 1;
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    explicit WorkStealingPool(const NumaTopology &topology, size_t threads_per_node = 0) : node_count(topology.nodes()) {
+        for (size_t node = 0; node < topology.nodes(); ++node) {
+            const std::vector<int> &cpus = topology.cpus(node);
+            size_t count = threads_per_node ? threads_per_node : cpus.size();
+            for (size_t i = 0; i < count; ++i) {
+                workers.push_back(std::make_unique<Worker>());
+                workers.back()->node = node;
+                workers.back()->cpu = cpus[i % cpus.size()];
+            }
+        }
+        for (size_t i = 1; i < workers.size(); ++i) {
+            threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+    size_t nodes() const { return node_count; }
+
+    size_t workerIndex() const {
+        const CurrentWorker &current = currentWorker();
+        if (current.pool != this) throw std::logic_error("thread is not running a task of this pool");
+        return current.index;
+    }
+
+    void parallelFor(size_t count, size_t grain, const Body &body) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+        size_t task_count = (count + grain - 1) / grain;
+        size_t per_worker = (task_count + workers.size() - 1) / workers.size();
+        failure = nullptr;
+        cross_node.store(true, std::memory_order_relaxed);
+        remaining.store(task_count, std::memory_order_release);
+        for (size_t w = 0; w < workers.size(); ++w) {
+            std::lock_guard<std::mutex> lock(workers[w]->mutex);
+            for (size_t t = w * per_worker; t < std::min(task_count, (w + 1) * per_worker); ++t) {
+                workers[w]->tasks.push_back({t * grain, std::min(count, (t + 1) * grain), &body});
+            }
+        }
+        start();
+    }
+
+    void parallelForNodes(const std::vector<size_t> &counts, size_t grain,
+                          const std::function<void(size_t, size_t, size_t)> &body, bool steal_across_nodes = true) {
+        if (grain == 0) grain = 1;
+        std::vector<Body> bodies;
+        std::vector<std::vector<size_t>> members(node_count);
+        for (size_t node = 0; node < node_count; ++node) {
+            bodies.push_back([&body, node](size_t begin, size_t end) { body(node, begin, end); });
+        }
+        for (size_t w = 0; w < workers.size(); ++w) {
+            members[workers[w]->node].push_back(w);
+        }
+        size_t task_count = 0;
+        for (size_t node = 0; node < node_count && node < counts.size(); ++node) {
+            task_count += (counts[node] + grain - 1) / grain;
+        }
+        if (task_count == 0) return;
+        failure = nullptr;
+        cross_node.store(steal_across_nodes, std::memory_order_relaxed);
+        remaining.store(task_count, std::memory_order_release);
+        for (size_t node = 0; node < node_count && node < counts.size(); ++node) {
+            size_t node_tasks = (counts[node] + grain - 1) / grain;
+            size_t per_worker = (node_tasks + members[node].size() - 1) / members[node].size();
+            for (size_t m = 0; m < members[node].size(); ++m) {
+                Worker &worker = *workers[members[node][m]];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                for (size_t t = m * per_worker; t < std::min(node_tasks, (m + 1) * per_worker); ++t) {
+                    worker.tasks.push_back({t * grain, std::min(counts[node], (t + 1) * grain), &bodies[node]});
+                }
+            }
+        }
+        start();
+    }
+
+private:
+    void start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++generation;
+        }
+        wake.notify_all();
+        {
+            NumaTopology::ScopedPin caller(workers[0]->cpu);
+            runTasks(0);
+        }
+        if (failure) std::rethrow_exception(failure);
+    }
+
+public:
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t department_count;
+    uint64_t record_count;
+    uint64_t instruction_count;
+    uint64_t string_bytes;
+};
+
+struct SnapshotString {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct SnapshotRecord {
+    uint64_t name_offset;
+    uint32_t name_length;
+    uint32_t department;
+    int64_t budget_cents;
+    uint64_t first_instruction;
+    uint32_t instruction_count;
+    uint8_t funded;
+    uint8_t completed;
+    uint16_t reserved;
+};
+
+struct SnapshotInstruction {
+    uint8_t op;
+    uint8_t reserved[3];
+    uint32_t operand;
+    int64_t imm;
+};
+
+inline constexpr char kSnapshotMagic[8] = {'G', 'O', 'V', 'S', 'N', 'A', 'P', 0};
+inline constexpr uint32_t kSnapshotVersion = 2;
+
+class SnapshotWriter {
+    std::string path;
+    std::string temp_path;
+    std::ofstream out;
+    SnapshotHeader header = {};
+    std::vector<SnapshotString> departments;
+    std::unordered_map<DepartmentId, uint32_t> department_index;
+    std::vector<SnapshotInstruction> instructions;
+    std::string strings;
+    bool finished = false;
+
+    uint32_t departmentIndex(DepartmentId id) {
+        auto inserted = department_index.emplace(id, static_cast<uint32_t>(departments.size()));
+        if (inserted.second) {
+            const std::string &name = DepartmentDictionary::global().name(id);
+            departments.push_back({strings.size(), static_cast<uint32_t>(name.size()), 0});
+            strings += name;
+        }
+        return inserted.first->second;
+    }
+
+public:
+    explicit SnapshotWriter(const std::string &snapshot_path)
+        : path(snapshot_path), temp_path(snapshot_path + ".tmp"),
+          out(temp_path, std::ios::binary | std::ios::trunc) {
+        if (!out) throw std::runtime_error("cannot create snapshot " + temp_path);
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    void add(GovernmentProject &project) {
+        ActionProgram program = project.lowerProgram();
+        SnapshotRecord record = {};
+        record.department = departmentIndex(project.getDepartmentId());
+        record.name_offset = strings.size();
+        record.name_length = static_cast<uint32_t>(project.getProjectName().size());
+        record.budget_cents = project.getBudget().cents();
+        record.first_instruction = instructions.size();
+        record.instruction_count = static_cast<uint32_t>(program.size());
+        record.funded = project.isFunded();
+        record.completed = project.isCompleted();
+        strings += project.getProjectName();
+        for (size_t i = 0; i < program.size(); ++i) {
+            const Instruction &instruction = program[i];
+            if (instruction.op == Opcode::Call) {
+                throw std::runtime_error("custom actions cannot be written to a snapshot");
+            }
+            SnapshotInstruction encoded = {};
+            encoded.op = static_cast<uint8_t>(instruction.op);
+            encoded.operand = instruction.op == Opcode::Transfer ? departmentIndex(instruction.operand)
+                                                                 : instruction.operand;
+            encoded.imm = instruction.op == Opcode::Transfer ? 0 : instruction.imm;
+            instructions.push_back(encoded);
+        }
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        ++header.record_count;
+    }
+
+    void finish() {
+        header.department_count = static_cast<uint32_t>(departments.size());
+        header.instruction_count = instructions.size();
+        header.string_bytes = strings.size();
+        out.write(reinterpret_cast<const char *>(departments.data()), departments.size() * sizeof(SnapshotString));
+        out.write(reinterpret_cast<const char *>(instructions.data()),
+                  instructions.size() * sizeof(SnapshotInstruction));
+        out.write(strings.data(), strings.size());
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("cannot write snapshot " + path);
+        }
+        finished = true;
+    }
+
+    ~SnapshotWriter() {
+        if (!finished) {
+            out.close();
+            std::remove(temp_path.c_str());
+        }
+    }
+};
+
+class MappedSnapshot {
+    const char *base = nullptr;
+    size_t length = 0;
+    const SnapshotHeader *header = nullptr;
+    const SnapshotRecord *records = nullptr;
+    const SnapshotString *departments = nullptr;
+    const SnapshotInstruction *instructions = nullptr;
+    const char *strings = nullptr;
+    std::vector<DepartmentId> department_ids;
+
+    static void corrupt(const std::string &what) {
+        throw std::runtime_error("corrupt snapshot: " + what);
+    }
+
+public:
+    explicit MappedSnapshot(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open snapshot " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat snapshot " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        void *mapping = length ? ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (mapping == MAP_FAILED) throw std::runtime_error("cannot map snapshot " + path);
+        base = static_cast<const char *>(mapping);
+        try {
+            validate();
+        } catch (...) {
+            ::munmap(const_cast<char *>(base), length);
+            throw;
+        }
+    }
+
+    MappedSnapshot(const MappedSnapshot &) = delete;
+    MappedSnapshot &operator=(const MappedSnapshot &) = delete;
+
+    void validate() {
+        if (length < sizeof(SnapshotHeader)) corrupt("truncated header");
+        header = reinterpret_cast<const SnapshotHeader *>(base);
+        if (std::memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) corrupt("bad magic");
+        if (header->version != kSnapshotVersion) corrupt("unsupported version");
+        size_t offset = sizeof(SnapshotHeader);
+        auto section = [&](uint64_t count, size_t width) {
+            if (count > (length - offset) / width) corrupt("truncated section");
+            const char *start = base + offset;
+            offset += count * width;
+            return start;
+        };
+        records = reinterpret_cast<const SnapshotRecord *>(section(header->record_count, sizeof(SnapshotRecord)));
+        departments = reinterpret_cast<const SnapshotString *>(
+            section(header->department_count, sizeof(SnapshotString)));
+        instructions = reinterpret_cast<const SnapshotInstruction *>(
+            section(header->instruction_count, sizeof(SnapshotInstruction)));
+        strings = section(header->string_bytes, 1);
+        for (uint32_t i = 0; i < header->department_count; ++i) {
+            department_ids.push_back(DepartmentDictionary::global().intern(string(departments[i].offset,
+                                                                                  departments[i].length)));
+        }
+    }
+
+    std::string_view string(uint64_t offset, uint64_t size) const {
+        if (offset > header->string_bytes || size > header->string_bytes - offset) corrupt("string out of range");
+        return std::string_view(strings + offset, size);
+    }
+
+    size_t size() const { return header->record_count; }
+
+    GovernmentProject *decode(size_t index) const {
+        const SnapshotRecord &record = records[index];
+        if (record.department >= department_ids.size()) corrupt("department out of range");
+        if (record.first_instruction > header->instruction_count ||
+            record.instruction_count > header->instruction_count - record.first_instruction) {
+            corrupt("action chain out of range");
+        }
+        std::vector<ActionStep> steps;
+        steps.reserve(record.instruction_count);
+        for (uint32_t i = 0; i < record.instruction_count; ++i) {
+            const SnapshotInstruction &encoded = instructions[record.first_instruction + i];
+            switch (static_cast<Opcode>(encoded.op)) {
+            case Opcode::Approve: steps.emplace_back(ApproveFunding()); break;
+            case Opcode::Adjust: steps.emplace_back(AdjustBudget(Money::fromCents(encoded.imm))); break;
+            case Opcode::Complete: steps.emplace_back(CompleteProject()); break;
+            case Opcode::CondGe:
+                if (encoded.operand >= record.instruction_count - i) corrupt("guard out of range");
+                steps.emplace_back(ConditionalStep{Money::fromCents(encoded.imm), encoded.operand});
+                break;
+            case Opcode::Transfer:
+                if (encoded.operand >= department_ids.size()) corrupt("department out of range");
+                steps.emplace_back(DepartmentTransfer(department_ids[encoded.operand]));
+                break;
+            case Opcode::Freeze: steps.emplace_back(BudgetFreeze()); break;
+            default: corrupt("unknown opcode");
+            }
+        }
+        auto *project = new GovernmentProject(std::string(string(record.name_offset, record.name_length)),
+                                              DepartmentDictionary::global().name(department_ids[record.department]),
+                                              record.funded != 0, Money::fromCents(record.budget_cents),
+                                              std::move(steps));
+        project->setCompleted(record.completed != 0);
+        return project;
+    }
+
+    ~MappedSnapshot() {
+        if (base) ::munmap(const_cast<char *>(base), length);
+    }
+};
+
+struct JournalEntry {
+    uint64_t project;
+    uint8_t fields;
+    ProjectState state;
+};
+
+class ProjectJournal {
+    enum RecordKind : uint8_t { kDeltaRecord = 1, kDepartmentRecord = 2 };
+
+    struct DeltaPayload {
+        uint8_t kind;
+        uint8_t fields;
+        uint8_t funded;
+        uint8_t completed;
+        uint32_t department;
+        uint64_t project;
+        int64_t budget_cents;
+    };
+
+    struct DepartmentPayload {
+        uint8_t kind;
+        uint8_t reserved[3];
+        uint32_t department;
+    };
+
+    int fd = -1;
+    size_t group_records;
+    std::mutex mutex;
+    std::condition_variable flushed;
+    std::string pending;
+    size_t pending_records = 0;
+    uint64_t appended = 0;
+    uint64_t durable = 0;
+    off_t durable_size = 0;
+    bool torn = false;
+    bool flushing = false;
+    size_t commit_count = 0;
+    std::vector<bool> logged_departments;
+
+    static uint32_t checksum(const char *data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    void appendFrame(const void *payload, size_t size, std::string_view tail = {}) {
+        uint32_t length = static_cast<uint32_t>(size + tail.size());
+        size_t start = pending.size();
+        pending.resize(start + 8 + length);
+        char *frame = &pending[start];
+        std::memcpy(frame + 8, payload, size);
+        if (!tail.empty()) std::memcpy(frame + 8 + size, tail.data(), tail.size());
+        uint32_t sum = checksum(frame + 8, length);
+        std::memcpy(frame, &length, 4);
+        std::memcpy(frame + 4, &sum, 4);
+        appended += 8 + length;
+    }
+
+    void flushUpTo(std::unique_lock<std::mutex> &lock, uint64_t target) {
+        while (durable < target) {
+            if (flushing) {
+                flushed.wait(lock);
+                continue;
+            }
+            flushing = true;
+            std::string batch;
+            batch.swap(pending);
+            size_t batch_records = pending_records;
+            pending_records = 0;
+            uint64_t end = appended;
+            bool repair = torn;
+            lock.unlock();
+            bool ok = !repair || ::ftruncate(fd, durable_size) == 0;
+            for (size_t written = 0; ok && written < batch.size();) {
+                ssize_t n = ::write(fd, batch.data() + written, batch.size() - written);
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                written += ok ? static_cast<size_t>(n) : 0;
+            }
+            ok = ok && ::fdatasync(fd) == 0;
+            lock.lock();
+            flushing = false;
+            flushed.notify_all();
+            if (!ok) {
+                torn = true;
+                pending.insert(0, batch);
+                pending_records += batch_records;
+                throw std::runtime_error("journal write failed");
+            }
+            torn = false;
+            durable = end;
+            durable_size += static_cast<off_t>(batch.size());
+            ++commit_count;
+        }
+    }
+
+public:
+    static constexpr size_t kGroupRecords = 4096;
+
+    explicit ProjectJournal(const std::string &path, size_t group_size = kGroupRecords)
+        : group_records(std::max<size_t>(1, group_size)) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::runtime_error("cannot open journal " + path);
+        durable_size = ::lseek(fd, 0, SEEK_END);
+        if (durable_size < 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot open journal " + path);
+        }
+    }
+
+    ProjectJournal(const ProjectJournal &) = delete;
+    ProjectJournal &operator=(const ProjectJournal &) = delete;
+
+    enum Field : uint8_t { kFunded = 1, kBudget = 2, kCompleted = 4, kDepartment = 8 };
+
+    void record(uint64_t project, const ProjectState &before, const ProjectState &after) {
+        uint8_t fields = (before.funded != after.funded ? kFunded : 0) |
+                         (before.budget != after.budget ? kBudget : 0) |
+                         (before.completed != after.completed ? kCompleted : 0) |
+                         (before.department != after.department ? kDepartment : 0);
+        if (!fields) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        if ((fields & kDepartment) &&
+            (after.department >= logged_departments.size() || !logged_departments[after.department])) {
+            if (after.department >= logged_departments.size()) logged_departments.resize(after.department + 1);
+            logged_departments[after.department] = true;
+            DepartmentPayload payload = {kDepartmentRecord, {}, after.department};
+            appendFrame(&payload, sizeof(payload), DepartmentDictionary::global().name(after.department));
+        }
+        DeltaPayload payload = {kDeltaRecord, fields, after.funded, after.completed,
+                                after.department, project, after.budget.cents()};
+        appendFrame(&payload, sizeof(payload));
+        if (++pending_records >= group_records && !flushing) flushUpTo(lock, appended);
+    }
+
+    void commit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        flushUpTo(lock, appended);
+    }
+
+    size_t commits() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return commit_count;
+    }
+
+    void truncate() {
+        std::unique_lock<std::mutex> lock(mutex);
+        flushUpTo(lock, appended);
+        if (::ftruncate(fd, 0) != 0 || ::fdatasync(fd) != 0) throw std::runtime_error("cannot truncate journal");
+        durable_size = 0;
+        logged_departments.clear();
+    }
+
+    static std::vector<JournalEntry> read(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::vector<JournalEntry> entries;
+        std::unordered_map<uint32_t, DepartmentId> departments;
+        for (size_t offset = 0; offset + 8 <= log.size();) {
+            uint32_t length, sum;
+            std::memcpy(&length, &log[offset], 4);
+            std::memcpy(&sum, &log[offset + 4], 4);
+            if (length == 0 || length > log.size() - offset - 8) break;
+            const char *payload = log.data() + offset + 8;
+            if (checksum(payload, length) != sum) break;
+            if (payload[0] == kDepartmentRecord && length >= sizeof(DepartmentPayload)) {
+                DepartmentPayload department;
+                std::memcpy(&department, payload, sizeof(department));
+                departments[department.department] = DepartmentDictionary::global().intern(
+                    std::string_view(payload + sizeof(department), length - sizeof(department)));
+            } else if (payload[0] == kDeltaRecord && length == sizeof(DeltaPayload)) {
+                DeltaPayload delta;
+                std::memcpy(&delta, payload, sizeof(delta));
+                JournalEntry entry = {delta.project, delta.fields,
+                                      {delta.funded != 0, delta.completed != 0,
+                                       Money::fromCents(delta.budget_cents), 0}};
+                if (delta.fields & kDepartment) {
+                    auto it = departments.find(delta.department);
+                    if (it == departments.end()) break;
+                    entry.state.department = it->second;
+                }
+                entries.push_back(entry);
+            } else {
+                break;
+            }
+            offset += 8 + length;
+        }
+        return entries;
+    }
+
+    ~ProjectJournal() {
+        try {
+            commit();
+        } catch (...) {
+        }
+        ::close(fd);
+    }
+};
+
+class BudgetIndex {
+    struct Entry {
+        Money budget;
+        size_t project;
+
+        bool operator<(const Entry &other) const {
+            return budget < other.budget || (budget == other.budget && project < other.project);
+        }
+        bool operator==(const Entry &other) const { return budget == other.budget && project == other.project; }
+    };
+
+    enum Location : uint8_t { kAbsent, kSorted, kLogged };
+
+    std::mutex mutex;
+    std::vector<Entry> sorted;
+    std::vector<Entry> inserted;
+    std::vector<Entry> removed;
+    std::vector<Money> indexed;
+    std::vector<Location> location;
+    std::vector<size_t> log_slot;
+    bool log_sorted = true;
+
+    void eraseLogged(size_t project) {
+        size_t slot = log_slot[project];
+        inserted[slot] = inserted.back();
+        log_slot[inserted[slot].project] = slot;
+        inserted.pop_back();
+    }
+
+    void sortLog() {
+        if (log_sorted) return;
+        std::sort(inserted.begin(), inserted.end());
+        std::sort(removed.begin(), removed.end());
+        for (size_t i = 0; i < inserted.size(); ++i) {
+            log_slot[inserted[i].project] = i;
+        }
+        log_sorted = true;
+    }
+
+    void compactLocked() {
+        sortLog();
+        std::vector<Entry> live;
+        live.reserve(sorted.size() - removed.size());
+        size_t r = 0;
+        for (const Entry &entry : sorted) {
+            while (r < removed.size() && removed[r] < entry) ++r;
+            if (r < removed.size() && removed[r] == entry) {
+                ++r;
+                continue;
+            }
+            live.push_back(entry);
+        }
+        std::vector<Entry> merged(live.size() + inserted.size());
+        std::merge(live.begin(), live.end(), inserted.begin(), inserted.end(), merged.begin());
+        for (const Entry &entry : inserted) {
+            location[entry.project] = kSorted;
+        }
+        sorted.swap(merged);
+        inserted.clear();
+        removed.clear();
+    }
+
+    template <typename Visit>
+    void scan(Money low, Money high, Visit visit) {
+        sortLog();
+        Entry first{low, 0};
+        Entry last{high, 0};
+        auto removed_it = std::lower_bound(removed.begin(), removed.end(), first);
+        auto end = std::lower_bound(sorted.begin(), sorted.end(), last);
+        for (auto it = std::lower_bound(sorted.begin(), end, first); it != end; ++it) {
+            while (removed_it != removed.end() && *removed_it < *it) ++removed_it;
+            if (removed_it != removed.end() && *removed_it == *it) {
+                ++removed_it;
+                continue;
+            }
+            visit(*it);
+        }
+        auto log_end = std::lower_bound(inserted.begin(), inserted.end(), last);
+        for (auto it = std::lower_bound(inserted.begin(), log_end, first); it != log_end; ++it) {
+            visit(*it);
+        }
+    }
+
+public:
+    static constexpr size_t kMinLog = 1024;
+
+    void update(size_t project, Money budget) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (project >= indexed.size()) {
+            indexed.resize(project + 1);
+            location.resize(project + 1, kAbsent);
+            log_slot.resize(project + 1, 0);
+        }
+        if (location[project] != kAbsent && indexed[project] == budget) return;
+        if (location[project] == kSorted) {
+            removed.push_back({indexed[project], project});
+        } else if (location[project] == kLogged) {
+            eraseLogged(project);
+        }
+        indexed[project] = budget;
+        log_slot[project] = inserted.size();
+        inserted.push_back({budget, project});
+        location[project] = kLogged;
+        log_sorted = false;
+        if (inserted.size() + removed.size() > std::max(kMinLog, sorted.size() / 16)) compactLocked();
+    }
+
+    void compact() {
+        std::lock_guard<std::mutex> lock(mutex);
+        compactLocked();
+    }
+
+    size_t count(Money low, Money high) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sortLog();
+        Entry first{low, 0};
+        Entry last{high, 0};
+        auto span = [&](const std::vector<Entry> &entries) {
+            return static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(), last) -
+                                       std::lower_bound(entries.begin(), entries.end(), first));
+        };
+        return span(sorted) - span(removed) + span(inserted);
+    }
+
+    std::vector<size_t> range(Money low, Money high) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Entry> matches;
+        scan(low, high, [&](const Entry &entry) { matches.push_back(entry); });
+        std::sort(matches.begin(), matches.end());
+        std::vector<size_t> projects;
+        projects.reserve(matches.size());
+        for (const Entry &entry : matches) {
+            projects.push_back(entry.project);
+        }
+        return projects;
+    }
+
+    size_t pendingUpdates() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inserted.size() + removed.size();
+    }
+};
+
+struct DepartmentAggregate {
+    DepartmentId department = 0;
+    size_t projects = 0;
+    size_t funded = 0;
+    size_t completed = 0;
+    Money total_budget;
+    Money funded_budget;
+
+    double averageBudget() const { return projects ? total_budget.toDouble() / projects : 0; }
+};
+
+class DepartmentIndex {
+    static constexpr DepartmentId kUnassigned = std::numeric_limits<DepartmentId>::max();
+
+    std::mutex mutex;
+    std::vector<std::vector<size_t>> members;
+    std::vector<DepartmentId> department_of;
+    std::vector<size_t> position;
+
+public:
+    void update(size_t project, DepartmentId department) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (project >= department_of.size()) {
+            department_of.resize(project + 1, kUnassigned);
+            position.resize(project + 1, 0);
+        }
+        DepartmentId old = department_of[project];
+        if (old == department) return;
+        if (old != kUnassigned) {
+            std::vector<size_t> &list = members[old];
+            size_t slot = position[project];
+            list[slot] = list.back();
+            position[list[slot]] = slot;
+            list.pop_back();
+        }
+        if (department >= members.size()) members.resize(department + 1);
+        position[project] = members[department].size();
+        members[department].push_back(project);
+        department_of[project] = department;
+    }
+
+    size_t count(DepartmentId department) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return department < members.size() ? members[department].size() : 0;
+    }
+
+    std::vector<size_t> projects(DepartmentId department) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return department < members.size() ? members[department] : std::vector<size_t>();
+    }
+};
+
+class ProjectSegments {
+    static constexpr size_t kFirstShift = 10;
+    static constexpr size_t kFirstSegment = size_t(1) << kFirstShift;
+    static constexpr size_t kSegments = 40;
+
+    using Slot = std::atomic<GovernmentProject *>;
+
+    std::atomic<Slot *> segments[kSegments] = {};
+    std::atomic<size_t> reserved{0};
+    std::atomic<size_t> published{0};
+
+    static size_t segmentOf(size_t index) { return 63 - __builtin_clzll(index + kFirstSegment) - kFirstShift; }
+    static size_t segmentStart(size_t segment) { return (kFirstSegment << segment) - kFirstSegment; }
+
+    Slot *find(size_t index) const {
+        size_t segment = segmentOf(index);
+        Slot *slots = segments[segment].load();
+        return slots ? &slots[index - segmentStart(segment)] : nullptr;
+    }
+
+    Slot &claim(size_t index) {
+        size_t segment = segmentOf(index);
+        Slot *slots = segments[segment].load(std::memory_order_acquire);
+        if (!slots) {
+            size_t length = kFirstSegment << segment;
+            Slot *fresh = new Slot[length];
+            for (size_t i = 0; i < length; ++i) {
+                fresh[i].store(nullptr, std::memory_order_relaxed);
+            }
+            if (segments[segment].compare_exchange_strong(slots, fresh)) {
+                slots = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return slots[index - segmentStart(segment)];
+    }
+
+    void advance() {
+        size_t end = published.load();
+        while (end < reserved.load()) {
+            Slot *slot = find(end);
+            if (!slot || !slot->load()) return;
+            if (published.compare_exchange_weak(end, end + 1)) ++end;
+        }
+    }
+
+public:
+    ProjectSegments() = default;
+    ProjectSegments(const ProjectSegments &) = delete;
+    ProjectSegments &operator=(const ProjectSegments &) = delete;
+
+    size_t reserve() { return reserved.fetch_add(1); }
+
+    void publish(size_t index, GovernmentProject *project) {
+        claim(index).store(project);
+        advance();
+    }
+
+    GovernmentProject *get(size_t index) const {
+        size_t segment = segmentOf(index);
+        Slot *slots = segments[segment].load(std::memory_order_relaxed);
+        return slots[index - segmentStart(segment)].load(std::memory_order_relaxed);
+    }
+
+    void set(size_t index, GovernmentProject *project) { find(index)->store(project, std::memory_order_release); }
+
+    template <typename Body>
+    void forEach(size_t begin, size_t end, Body body) const {
+        while (begin < end) {
+            size_t segment = segmentOf(begin);
+            size_t base = segmentStart(segment);
+            size_t stop = std::min(end, segmentStart(segment + 1));
+            Slot *slots = segments[segment].load(std::memory_order_relaxed);
+            for (; begin < stop; ++begin) {
+                body(begin, slots[begin - base].load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    size_t size() const { return published.load(std::memory_order_acquire); }
+    bool empty() const { return reserved.load(std::memory_order_acquire) == 0; }
+
+    void assign(size_t count) {
+        for (size_t index = 0; index < count; index = segmentStart(segmentOf(index) + 1)) {
+            claim(index);
+        }
+        reserved.store(count, std::memory_order_release);
+        published.store(count, std::memory_order_release);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < size(); ++i) {
+            set(i, nullptr);
+        }
+        reserved.store(0, std::memory_order_release);
+        published.store(0, std::memory_order_release);
+    }
+
+    ~ProjectSegments() {
+        for (auto &segment : segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+class ProjectRegistry : public ProjectObserver {
+    friend class ShardedRegistry;
+
+    ProjectSegments projects;
+    ProjectArena arena;
+    std::unique_ptr<MappedSnapshot> snapshot;
+    std::mutex dirty_mutex;
+    std::vector<GovernmentProject*> dirty_projects;
+    size_t fresh = 0;
+    ProjectJournal *journal = nullptr;
+    std::unique_ptr<BudgetIndex> budget_index;
+    std::unique_ptr<DepartmentIndex> department_index;
+    std::unique_ptr<WorkStealingPool> default_pool;
+
+    GovernmentProject *at(size_t i) {
+        GovernmentProject *project = projects.get(i);
+        if (!project) {
+            project = snapshot->decode(i);
+            project->setObserver(this);
+            project->setRegistryIndex(i);
+            projects.set(i, project);
+        }
+        return project;
+    }
+
+    template <typename Body>
+    void each(size_t begin, size_t end, Body body) {
+        projects.forEach(begin, end, [&](size_t i, GovernmentProject *project) {
+            body(project ? project : at(i));
+        });
+    }
+
+    WorkStealingPool &defaultPool() {
+        if (!default_pool) default_pool = std::make_unique<WorkStealingPool>();
+        return *default_pool;
+    }
+
+    void track(GovernmentProject *project) {
+        size_t index = projects.reserve();
+        project->setObserver(this);
+        project->setRegistryIndex(index);
+        project->setDirty(true);
+        if (budget_index) budget_index->update(index, project->getBudget());
+        if (department_index) department_index->update(index, project->getDepartmentId());
+        projects.publish(index, project);
+    }
+
+    void processed(GovernmentProject *project, const ProjectState &before) {
+        ProjectState after = project->state();
+        if (journal) journal->record(project->getRegistryIndex(), before, after);
+        if (budget_index && before.budget != after.budget) {
+            budget_index->update(project->getRegistryIndex(), after.budget);
+        }
+        if (department_index && before.department != after.department) {
+            department_index->update(project->getRegistryIndex(), after.department);
+        }
+    }
+
+    void run(GovernmentProject *project) {
+        if (!journal && !budget_index && !department_index) {
+            project->process();
+            return;
+        }
+        ProjectState before = project->state();
+        project->process();
+        processed(project, before);
+    }
+
+    template <typename Action>
+    void runAction(GovernmentProject *project, Action &action) {
+        if (!journal && !budget_index && !department_index) {
+            project->apply(action);
+            return;
+        }
+        ProjectState before = project->state();
+        project->apply(action);
+        processed(project, before);
+    }
+
+    bool runTransaction(GovernmentProject *project, ProjectValidator &validator) {
+        ProjectState before = project->state();
+        bool committed = project->processTransaction(validator);
+        processed(project, before);
+        return committed;
+    }
+
+    void finishPass() {
+        if (journal) journal->commit();
+    }
+
+    void clearDirty(size_t processed) {
+        std::lock_guard<std::mutex> lock(dirty_mutex);
+        for (auto *project : dirty_projects) {
+            project->setDirty(false);
+        }
+        dirty_projects.clear();
+        for (; fresh < processed; ++fresh) {
+            at(fresh)->setDirty(false);
+        }
+    }
+
+    std::vector<GovernmentProject*> takeDirty() {
+        size_t end = projects.size();
+        std::lock_guard<std::mutex> lock(dirty_mutex);
+        std::vector<GovernmentProject*> taken;
+        taken.swap(dirty_projects);
+        for (; fresh < end; ++fresh) {
+            taken.push_back(at(fresh));
+        }
+        for (auto *project : taken) {
+            project->setDirty(false);
+        }
+        return taken;
+    }
+
+public:
+    static constexpr size_t kParallelGrain = 1024;
+
+    void addProject(GovernmentProject *project) {
+        track(project);
+    }
+
+    void projectChanged(GovernmentProject &project) override {
+        if (budget_index) budget_index->update(project.getRegistryIndex(), project.getBudget());
+        if (department_index) department_index->update(project.getRegistryIndex(), project.getDepartmentId());
+        std::lock_guard<std::mutex> lock(dirty_mutex);
+        if (project.isDirty()) return;
+        project.setDirty(true);
+        dirty_projects.push_back(&project);
+    }
+
+    BudgetIndex &enableBudgetIndex() {
+        if (!budget_index) {
+            auto index = std::make_unique<BudgetIndex>();
+            for (size_t i = 0; i < projects.size(); ++i) {
+                index->update(i, at(i)->getBudget());
+            }
+            index->compact();
+            budget_index = std::move(index);
+        }
+        return *budget_index;
+    }
+
+    std::vector<DepartmentAggregate> aggregateByDepartment(WorkStealingPool &pool) {
+        std::vector<std::vector<DepartmentAggregate>> partials(pool.size());
+        pool.parallelFor(projects.size(), kParallelGrain, [&](size_t begin, size_t end) {
+            std::vector<DepartmentAggregate> &local = partials[pool.workerIndex()];
+            for (size_t i = begin; i < end; ++i) {
+                const GovernmentProject *project = at(i);
+                DepartmentId department = project->getDepartmentId();
+                if (department >= local.size()) local.resize(department + 1);
+                DepartmentAggregate &partial = local[department];
+                ++partial.projects;
+                partial.total_budget += project->getBudget();
+                if (project->isFunded()) {
+                    ++partial.funded;
+                    partial.funded_budget += project->getBudget();
+                }
+                if (project->isCompleted()) ++partial.completed;
+            }
+        });
+        std::vector<DepartmentAggregate> result;
+        for (auto &local : partials) {
+            if (local.size() > result.size()) result.resize(local.size());
+            for (size_t d = 0; d < local.size(); ++d) {
+                result[d].projects += local[d].projects;
+                result[d].funded += local[d].funded;
+                result[d].completed += local[d].completed;
+                result[d].total_budget += local[d].total_budget;
+                result[d].funded_budget += local[d].funded_budget;
+            }
+        }
+        for (size_t d = 0; d < result.size(); ++d) {
+            result[d].department = static_cast<DepartmentId>(d);
+        }
+        return result;
+    }
+
+    std::vector<DepartmentAggregate> aggregateByDepartment() {
+        return aggregateByDepartment(defaultPool());
+    }
+
+    DepartmentIndex &enableDepartmentIndex() {
+        if (!department_index) {
+            auto index = std::make_unique<DepartmentIndex>();
+            for (size_t i = 0; i < projects.size(); ++i) {
+                index->update(i, at(i)->getDepartmentId());
+            }
+            department_index = std::move(index);
+        }
+        return *department_index;
+    }
+
+    size_t countInDepartment(DepartmentId department) {
+        return enableDepartmentIndex().count(department);
+    }
+
+    std::vector<GovernmentProject*> projectsInDepartment(DepartmentId department) {
+        std::vector<GovernmentProject*> members;
+        for (size_t i : enableDepartmentIndex().projects(department)) {
+            members.push_back(at(i));
+        }
+        return members;
+    }
+
+    std::vector<GovernmentProject*> projectsInDepartment(std::string_view department) {
+        return projectsInDepartment(DepartmentDictionary::global().intern(department));
+    }
+
+    size_t countBudgetRange(Money low, Money high) {
+        return enableBudgetIndex().count(low, high);
+    }
+
+    std::vector<GovernmentProject*> budgetRange(Money low, Money high) {
+        std::vector<GovernmentProject*> matches;
+        for (size_t i : enableBudgetIndex().range(low, high)) {
+            matches.push_back(at(i));
+        }
+        return matches;
+    }
+
+    size_t dirtyCount() {
+        size_t end = projects.size();
+        std::lock_guard<std::mutex> lock(dirty_mutex);
+        return dirty_projects.size() + (end - fresh);
+    }
+
+    void processDirty() {
+        for (auto *project : takeDirty()) {
+            run(project);
+        }
+        finishPass();
+    }
+
+    void processDirty(WorkStealingPool &pool) {
+        std::vector<GovernmentProject*> changed = takeDirty();
+        pool.parallelFor(changed.size(), kParallelGrain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                run(changed[i]);
+            }
+        });
+        finishPass();
+    }
+
+    void setJournal(ProjectJournal *project_journal) { journal = project_journal; }
+
+    size_t recoverJournal(const std::string &path, WorkStealingPool &pool) {
+        std::vector<JournalEntry> entries = ProjectJournal::read(path);
+        std::vector<std::vector<const JournalEntry *>> partitions(pool.size());
+        for (const auto &entry : entries) {
+            if (entry.project >= projects.size()) throw std::runtime_error("journal refers to unknown project");
+            partitions[entry.project % partitions.size()].push_back(&entry);
+        }
+        pool.parallelFor(partitions.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                for (const JournalEntry *entry : partitions[p]) {
+                    GovernmentProject *project = at(entry->project);
+                    ProjectState state = project->state();
+                    if (entry->fields & ProjectJournal::kFunded) state.funded = entry->state.funded;
+                    if (entry->fields & ProjectJournal::kBudget) state.budget = entry->state.budget;
+                    if (entry->fields & ProjectJournal::kCompleted) state.completed = entry->state.completed;
+                    if (entry->fields & ProjectJournal::kDepartment) state.department = entry->state.department;
+                    project->restoreState(state);
+                    if (budget_index) budget_index->update(entry->project, state.budget);
+                    if (department_index) department_index->update(entry->project, state.department);
+                }
+            }
+        });
+        return entries.size();
+    }
+
+    template <typename T, typename... Args>
+    T *createAction(Args &&...args) {
+        if constexpr (StatelessAction<T>::value) {
+            return sharedAction<T>();
+        } else {
+            return arena.create<T>(std::forward<Args>(args)...);
+        }
+    }
+
+    GovernmentProject *createProject(std::string name, std::string_view dept,
+                                     bool funded, Money budget_amount,
+                                     const std::vector<ProjectAction*> &acts) {
+        GovernmentProject *project = arena.create<GovernmentProject>(std::move(name), dept, funded, budget_amount, acts);
+        track(project);
+        return project;
+    }
+
+    GovernmentProject *createProject(std::string name, std::string_view dept,
+                                     bool funded, Money budget_amount,
+                                     std::vector<ActionStep> steps) {
+        GovernmentProject *project =
+            arena.create<GovernmentProject>(std::move(name), dept, funded, budget_amount, std::move(steps));
+        track(project);
+        return project;
+    }
+
+    void absorb(ProjectRegistry &other) {
+        for (size_t i = 0; i < other.projects.size(); ++i) {
+            track(other.at(i));
+        }
+        other.projects.clear();
+        other.dirty_projects.clear();
+        other.fresh = 0;
+        arena.absorb(other.arena);
+    }
+
+    const ProjectArena &getArena() const { return arena; }
+    size_t size() const { return projects.size(); }
+    GovernmentProject *getProject(size_t i) { return at(i); }
+    bool isLoaded(size_t i) const { return projects.get(i) != nullptr; }
+
+    void loadSnapshot(const std::string &path) {
+        if (!projects.empty()) throw std::logic_error("snapshots can only be loaded into an empty registry");
+        snapshot = std::make_unique<MappedSnapshot>(path);
+        projects.assign(snapshot->size());
+        fresh = snapshot->size();
+    }
+
+    void saveSnapshot(const std::string &path) {
+        SnapshotWriter writer(path);
+        for (size_t i = 0; i < projects.size(); ++i) {
+            writer.add(*at(i));
+        }
+        writer.finish();
+    }
+
+    void processAll() {
+        size_t count = projects.size();
+        each(0, count, [this](GovernmentProject *project) { run(project); });
+        clearDirty(count);
+        finishPass();
+    }
+
+    void processAllParallel(WorkStealingPool &pool) {
+        size_t count = projects.size();
+        pool.parallelFor(count, kParallelGrain, [this](size_t begin, size_t end) {
+            each(begin, end, [this](GovernmentProject *project) { run(project); });
+        });
+        clearDirty(count);
+        finishPass();
+    }
+
+    void processAllParallel() {
+        processAllParallel(defaultPool());
+    }
+
+    template <typename Action>
+    void applyAll(Action &action) {
+        each(0, projects.size(), [&](GovernmentProject *project) { runAction(project, action); });
+        finishPass();
+    }
+
+    template <typename Action>
+    void applyAllParallel(Action &action, WorkStealingPool &pool) {
+        pool.parallelFor(projects.size(), kParallelGrain, [&](size_t begin, size_t end) {
+            each(begin, end, [&](GovernmentProject *project) { runAction(project, action); });
+        });
+        finishPass();
+    }
+
+    size_t processAllTransactional(ProjectValidator &validator) {
+        size_t rolled_back = 0;
+        size_t count = projects.size();
+        each(0, count, [&](GovernmentProject *project) {
+            if (!runTransaction(project, validator)) ++rolled_back;
+        });
+        clearDirty(count);
+        finishPass();
+        return rolled_back;
+    }
+
+    size_t processAllTransactional(ProjectValidator &validator, WorkStealingPool &pool) {
+        std::atomic<size_t> rolled_back{0};
+        size_t count = projects.size();
+        pool.parallelFor(count, kParallelGrain, [&](size_t begin, size_t end) {
+            size_t local = 0;
+            each(begin, end, [&](GovernmentProject *project) {
+                if (!runTransaction(project, validator)) ++local;
+            });
+            rolled_back.fetch_add(local, std::memory_order_relaxed);
+        });
+        clearDirty(count);
+        finishPass();
+        return rolled_back.load();
+    }
+
+    void compileAll() {
+        for (size_t i = 0; i < projects.size(); ++i) {
+            at(i)->compile();
+        }
+    }
+
+    void compileAllNative(JitCache &cache = JitCache::global()) {
+        for (size_t i = 0; i < projects.size(); ++i) {
+            at(i)->compileNative(cache);
+        }
+    }
+
+    OptimizationReport optimizeAll() {
+        OptimizationReport report;
+        for (size_t i = 0; i < projects.size(); ++i) {
+            report.merge(at(i)->optimize());
+        }
+        return report;
+    }
+
+    ~ProjectRegistry() {
+        for (size_t i = 0; i < projects.size(); ++i) {
+            GovernmentProject *project = projects.get(i);
+            if (project && !project->isArenaAllocated()) delete project;
+        }
+    }
+};
+
+class ShardedRegistry {
+    WorkStealingPool pool;
+    std::vector<std::unique_ptr<ProjectRegistry>> shards;
+    std::atomic<size_t> next{0};
+
+public:
+    explicit ShardedRegistry(const NumaTopology &topology = NumaTopology::system(), size_t threads_per_node = 0)
+        : pool(topology, threads_per_node) {
+        for (size_t node = 0; node < topology.nodes(); ++node) {
+            shards.push_back(std::make_unique<ProjectRegistry>());
+        }
+    }
+
+    ShardedRegistry(const ShardedRegistry &) = delete;
+    ShardedRegistry &operator=(const ShardedRegistry &) = delete;
+
+    size_t shardCount() const { return shards.size(); }
+    ProjectRegistry &shard(size_t node) { return *shards[node]; }
+    WorkStealingPool &getPool() { return pool; }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto &shard : shards) {
+            total += shard->size();
+        }
+        return total;
+    }
+
+    void addProject(GovernmentProject *project) {
+        shards[next.fetch_add(1, std::memory_order_relaxed) % shards.size()]->addProject(project);
+    }
+
+    template <typename Factory>
+    void populate(size_t count, Factory factory) {
+        std::vector<size_t> counts(shards.size(), count / shards.size());
+        for (size_t node = 0; node < count % shards.size(); ++node) {
+            ++counts[node];
+        }
+        pool.parallelForNodes(counts, std::max<size_t>(1, count), [&](size_t node, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                factory(*shards[node], i * shards.size() + node);
+            }
+        }, false);
+    }
+
+    void processAll() {
+        std::vector<size_t> counts;
+        for (auto &shard : shards) {
+            counts.push_back(shard->projects.size());
+        }
+        pool.parallelForNodes(counts, ProjectRegistry::kParallelGrain, [this](size_t node, size_t begin, size_t end) {
+            ProjectRegistry &shard = *shards[node];
+            shard.each(begin, end, [&shard](GovernmentProject *project) { shard.run(project); });
+        });
+        for (size_t node = 0; node < shards.size(); ++node) {
+            shards[node]->clearDirty(counts[node]);
+            shards[node]->finishPass();
+        }
+    }
+
+    void compileAll() {
+        pool.parallelForNodes(std::vector<size_t>(shards.size(), 1), 1, [this](size_t node, size_t, size_t) {
+            shards[node]->compileAll();
+        }, false);
+    }
+};
+
+class CsvProjectLoader {
+    static constexpr size_t kPiecesPerThread = 4;
+
+    [[noreturn]] static void malformed(size_t offset, const char *what) {
+        throw std::runtime_error("malformed CSV record at byte " + std::to_string(offset) + ": " + what);
+    }
+
+    static Money parseAmount(std::string_view text, size_t offset) {
+        Money value;
+        if (!Money::parse(text, value)) malformed(offset, "bad amount");
+        return value;
+    }
+
+    static size_t parseAction(std::string_view token, std::vector<ActionStep> &steps, size_t offset) {
+        size_t colon = token.find(':');
+        std::string_view kind = token.substr(0, colon);
+        std::string_view argument = colon == std::string_view::npos ? std::string_view() : token.substr(colon + 1);
+        if (kind == "approve") {
+            steps.emplace_back(ApproveFunding());
+        } else if (kind == "complete") {
+            steps.emplace_back(CompleteProject());
+        } else if (kind == "freeze") {
+            steps.emplace_back(BudgetFreeze());
+        } else if (kind == "adjust") {
+            steps.emplace_back(AdjustBudget(parseAmount(argument, offset)));
+        } else if (kind == "transfer") {
+            if (argument.empty()) malformed(offset, "transfer without department");
+            steps.emplace_back(DepartmentTransfer(argument));
+        } else if (kind == "cond") {
+            size_t split = argument.find(':');
+            if (split == std::string_view::npos) malformed(offset, "cond without action");
+            size_t guard = steps.size();
+            steps.emplace_back(ConditionalStep{parseAmount(argument.substr(0, split), offset), 0});
+            size_t guarded = parseAction(argument.substr(split + 1), steps, offset);
+            std::get<ConditionalStep>(steps[guard]).guarded = static_cast<uint32_t>(guarded);
+            return guarded + 1;
+        } else {
+            malformed(offset, "unknown action");
+        }
+        return 1;
+    }
+
+    static void parseLine(std::string_view line, size_t offset, ProjectRegistry &shard) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) return;
+        std::string_view fields[5];
+        for (size_t f = 0; f < 4; ++f) {
+            size_t comma = line.find(',');
+            if (comma == std::string_view::npos) malformed(offset, "expected 5 fields");
+            fields[f] = line.substr(0, comma);
+            line.remove_prefix(comma + 1);
+        }
+        if (line.find(',') != std::string_view::npos) malformed(offset, "expected 5 fields");
+        fields[4] = line;
+        bool funded;
+        if (fields[2] == "1" || fields[2] == "true") {
+            funded = true;
+        } else if (fields[2] == "0" || fields[2] == "false") {
+            funded = false;
+        } else {
+            malformed(offset, "bad funded flag");
+        }
+        std::vector<ActionStep> steps;
+        for (std::string_view chain = fields[4]; !chain.empty();) {
+            size_t semicolon = chain.find(';');
+            parseAction(chain.substr(0, semicolon), steps, offset);
+            chain = semicolon == std::string_view::npos ? std::string_view() : chain.substr(semicolon + 1);
+        }
+        shard.createProject(std::string(fields[0]), fields[1], funded, parseAmount(fields[3], offset),
+                            std::move(steps));
+    }
+
+    static void parsePiece(std::string_view piece, size_t offset, ProjectRegistry &shard) {
+        while (!piece.empty()) {
+            size_t newline = piece.find('\n');
+            std::string_view line = piece.substr(0, newline);
+            parseLine(line, offset, shard);
+            if (newline == std::string_view::npos) break;
+            piece.remove_prefix(newline + 1);
+            offset += newline + 1;
+        }
+    }
+
+public:
+    static constexpr size_t kChunkBytes = 64 << 20;
+
+    static void load(const std::string &path, ProjectRegistry &registry, WorkStealingPool &pool,
+                     size_t chunk_bytes = kChunkBytes) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("cannot open CSV " + path);
+        std::string buffer;
+        size_t buffer_offset = 0;
+        bool first_chunk = true;
+        for (;;) {
+            size_t carried = buffer.size();
+            buffer.resize(carried + chunk_bytes);
+            in.read(&buffer[carried], static_cast<std::streamsize>(chunk_bytes));
+            buffer.resize(carried + static_cast<size_t>(in.gcount()));
+            bool done = !in;
+            size_t usable = done ? buffer.size() : buffer.rfind('\n') + 1;
+            if (usable == 0 && !done) continue;
+            std::string_view text(buffer.data(), usable);
+            size_t skipped = 0;
+            if (first_chunk && text.substr(0, 5) == "name,") {
+                skipped = std::min(text.size(), text.find('\n') + 1);
+            }
+            first_chunk = false;
+
+            std::vector<std::pair<size_t, size_t>> pieces;
+            size_t target = std::max<size_t>(1, (usable - skipped) / (pool.size() * kPiecesPerThread));
+            for (size_t begin = skipped; begin < usable;) {
+                size_t end = std::min(usable, begin + target);
+                if (end < usable) {
+                    size_t newline = text.find('\n', end);
+                    end = newline == std::string_view::npos ? usable : newline + 1;
+                }
+                pieces.emplace_back(begin, end);
+                begin = end;
+            }
+            std::vector<std::unique_ptr<ProjectRegistry>> shards;
+            for (size_t i = 0; i < pieces.size(); ++i) {
+                shards.push_back(std::make_unique<ProjectRegistry>());
+            }
+            pool.parallelFor(pieces.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    parsePiece(text.substr(pieces[i].first, pieces[i].second - pieces[i].first),
+                               buffer_offset + pieces[i].first, *shards[i]);
+                }
+            });
+            for (auto &shard : shards) {
+                registry.absorb(*shard);
+            }
+            if (done) break;
+            buffer.erase(0, usable);
+            buffer_offset += usable;
+        }
+    }
+};
+
+#endif